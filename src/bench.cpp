@@ -0,0 +1,249 @@
+#include <arpa/nameser.h>
+#include <arpa/nameser_compat.h>
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "./dns_client.hpp"
+#include "./dns_decoder.hpp"
+#include "./dns_histogram.hpp"
+#include "./dns_query.hpp"
+#include "./dns_tester.hpp"
+
+// Microbenchmarks of the work the client does per query. Inputs are built
+// from fixed seeds, so the numbers of two commits can be compared with
+// benchmark's compare.py.
+
+namespace {
+
+// names queried for every type. PTR takes an IPv4 address.
+const char* queryName(const dns::Type type) {
+    return type == dns::PTR ? "192.0.2.1" : "www.example.com";
+}
+
+// writes one record of type on the question name and returns its length.
+size_t putRecord(const dns::Type type, unsigned char* cp) {
+    unsigned char* start = cp;
+
+    // a pointer to the question name.
+    ns_put16(0xc000 | NS_HFIXEDSZ, cp);
+    ns_put16(dns::typeCode(type), cp + 2);
+    ns_put16(ns_c_in, cp + 4);
+    ns_put32(300, cp + 6);
+    cp += 10 + NS_INT16SZ;
+
+    unsigned char* rdata = cp;
+    switch (type) {
+        case dns::A:
+            std::memcpy(cp, "\xc0\x00\x02\x01", 4);
+            cp += 4;
+            break;
+        case dns::AAAA:
+            std::memcpy(cp, "\x20\x01\x0d\xb8\0\0\0\0\0\0\0\0\0\0\0\x01", 16);
+            cp += 16;
+            break;
+        case dns::TXT:
+            *cp++ = 23;
+            std::memcpy(cp, "v=spf1 -all benchmarked", 23);
+            cp += 23;
+            break;
+        case dns::MX:
+            ns_put16(10, cp);
+            cp += NS_INT16SZ;
+            [[fallthrough]];
+        case dns::PTR:
+        case dns::CNAME:
+        case dns::NS:
+            std::memcpy(cp, "\x04mail\xc0\x10", 7);
+            cp += 7;
+            break;
+        case dns::SOA:
+            std::memcpy(cp, "\x03ns1\xc0\x10\x0ahostmaster\xc0\x10", 20);
+            cp += 20;
+            for (uint32_t value : {2024010101u, 7200u, 3600u, 1209600u, 300u}) {
+                ns_put32(value, cp);
+                cp += NS_INT32SZ;
+            }
+            break;
+    }
+    ns_put16(cp - rdata, rdata - NS_INT16SZ);
+
+    return cp - start;
+}
+
+// respond() makes an answer to the query for type with count records, as a
+// name server would send it.
+std::vector<unsigned char> respond(const dns::Type type,
+                                   const unsigned int count) {
+    std::vector<unsigned char> buf(DNS_BUFFER_SIZE * 4);
+    int qlen = dns::encode(queryName(type), type, true, false, buf.data(),
+                           buf.size());
+
+    HEADER* hp = (HEADER*)buf.data();
+    hp->id = htons(0x1234);
+    hp->qr = 1;
+    hp->ra = 1;
+    hp->ancount = htons(count);
+
+    size_t length = qlen;
+    for (unsigned int i = 0; i < count; i++) {
+        length += putRecord(type, buf.data() + length);
+    }
+    buf.resize(length);
+
+    return buf;
+}
+
+// query construction of Resolver, done for every lookup.
+void BM_Encode(benchmark::State& state) {
+    dns::Type type = static_cast<dns::Type>(state.range(0));
+    unsigned char query[DNS_BUFFER_SIZE];
+
+    for (auto _ : state) {
+        int qlen = dns::encode(queryName(type), type, true, true, query,
+                               sizeof(query));
+        benchmark::DoNotOptimize(qlen);
+        benchmark::ClobberMemory();
+    }
+    state.SetLabel(dns::typeName(type));
+}
+BENCHMARK(BM_Encode)->DenseRange(dns::A, dns::SOA);
+
+// what the engine does per query instead: patch the ID (and the random
+// label) of a query encoded once.
+void BM_ArenaPatch(benchmark::State& state) {
+    dns::QueryArena arena;
+    int index = arena.add("www.example.com", dns::A, true, true,
+                          state.range(0));
+    std::mt19937_64 random(1);
+    uint16_t id = 0;
+
+    for (auto _ : state) {
+        unsigned char* query = arena.data(index);
+        ns_put16(id++, query);
+        if (state.range(0) > 0) arena.label(index, random());
+        benchmark::DoNotOptimize(query);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_ArenaPatch)->Arg(0)->Arg(8)->Arg(16);
+
+// full decoding of an answer, as Resolver does.
+void BM_Parse(benchmark::State& state) {
+    dns::Type type = static_cast<dns::Type>(state.range(0));
+    std::vector<unsigned char> response = respond(type, state.range(1));
+    std::chrono::duration<double, std::milli> elapsed(1.0);
+
+    for (auto _ : state) {
+        std::shared_ptr<dns::Answer> answer =
+            dns::Client::parse(response.data(), response.size(), elapsed);
+        benchmark::DoNotOptimize(answer);
+    }
+    state.SetLabel(dns::typeName(type));
+    state.SetBytesProcessed(state.iterations() * response.size());
+}
+BENCHMARK(BM_Parse)->ArgsProduct({benchmark::CreateDenseRange(dns::A,
+                                                              dns::SOA, 1),
+                                  {1, 8}});
+
+// the in-place validation the engine does per answer.
+void BM_Validate(benchmark::State& state) {
+    dns::Type type = static_cast<dns::Type>(state.range(0));
+    std::vector<unsigned char> response = respond(type, state.range(1));
+    dns::Summary summary;
+
+    for (auto _ : state) {
+        int ret = dns::validate(response.data(), response.size(), summary);
+        benchmark::DoNotOptimize(ret);
+        benchmark::DoNotOptimize(summary);
+    }
+    state.SetLabel(dns::typeName(type));
+    state.SetBytesProcessed(state.iterations() * response.size());
+}
+BENCHMARK(BM_Validate)->ArgsProduct({benchmark::CreateDenseRange(dns::A,
+                                                                 dns::SOA, 1),
+                                     {1, 8}});
+
+// answer times spread like those of a real run: mostly around 1ms with a
+// long tail.
+std::vector<uint64_t> latencies(const size_t count) {
+    std::mt19937_64 random(1);
+    std::lognormal_distribution<double> distribution(13.8, 0.6);
+    std::vector<uint64_t> values(count);
+    for (uint64_t& value : values) value = distribution(random);
+    return values;
+}
+
+// recording of every answer time by a worker.
+void BM_Record(benchmark::State& state) {
+    std::vector<uint64_t> values = latencies(1 << 16);
+    dns::Histogram histogram;
+    size_t i = 0;
+
+    for (auto _ : state) {
+        histogram.record(values[i++ & (values.size() - 1)]);
+    }
+    benchmark::DoNotOptimize(histogram.count());
+}
+BENCHMARK(BM_Record);
+
+// Tester::report(): the results of every worker, filled as doTest() does for
+// samples answers over workers threads, are aggregated, and the percentiles
+// of the report are read.
+void BM_Report(benchmark::State& state) {
+    const size_t samples = state.range(0);
+    const size_t workers = state.range(1);
+
+    std::vector<uint64_t> values = latencies(samples);
+    std::vector<dns::Tester::WorkerStats> results(workers);
+    dns::Summary summary{};
+    summary.status = dns::Summary::Ok;
+    summary.recurse = true;
+    for (size_t i = 0; i < samples; i++) {
+        dns::Tester::WorkerStats& result = results[i % workers];
+        dns::TypeStats& typed = result.types[i % dns::TYPE_NUM];
+        dns::TypeStats& named = i % 4 ? result.unique : result.fixed;
+        summary.rcode = i % 4 ? ns_r_nxdomain : ns_r_noerror;
+        result.outcomes.count(summary);
+        typed.outcomes.count(summary);
+        named.outcomes.count(summary);
+        result.success++;
+        typed.success++;
+        named.success++;
+        result.latency.record(values[i]);
+        typed.latency.record(values[i]);
+        named.latency.record(values[i]);
+    }
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point end = start + std::chrono::seconds(1);
+    for (dns::Tester::WorkerStats& result : results) result.sent = end;
+
+    for (auto _ : state) {
+        std::unique_ptr<dns::TestStats> stats =
+            dns::Tester::aggregate(results, start, end, 0);
+
+        std::array<double, 6> percentiles;
+        size_t i = 0;
+        for (double p : {50.0, 90.0, 95.0, 99.0, 99.9, 99.99}) {
+            percentiles[i++] = stats->percentile(p);
+        }
+        benchmark::DoNotOptimize(percentiles);
+        benchmark::DoNotOptimize(stats->avgTime);
+    }
+    state.SetItemsProcessed(state.iterations() * samples);
+}
+BENCHMARK(BM_Report)
+    ->Args({1 << 20, 1})
+    ->Args({1 << 20, 16})
+    ->Args({1 << 22, 64})
+    ->Unit(benchmark::kMicrosecond);
+}  // namespace
+
+BENCHMARK_MAIN();
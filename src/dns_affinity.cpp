@@ -0,0 +1,79 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include <iostream>
+#include <fstream>
+#include <charconv>
+#include <cstring>
+
+#include "./dns_affinity.hpp"
+#include "./utils.hpp"
+
+namespace dns {
+
+// reads a CPU number at the front of list.
+static bool parseCpu(std::string_view& list, int& cpu) {
+    auto [ptr, ec] = std::from_chars(list.data(), list.data() + list.size(), cpu);
+    if (ec != std::errc() || cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    list.remove_prefix(ptr - list.data());
+    return true;
+}
+
+int parseCpus(const std::string_view list, std::vector<int>& cpus) {
+    std::string_view rest = list;
+    while (!rest.empty()) {
+        int first, last;
+        if (!parseCpu(rest, first)) return 1;
+        last = first;
+        if (!rest.empty() && rest.front() == '-') {
+            rest.remove_prefix(1);
+            if (!parseCpu(rest, last) || last < first) return 1;
+        }
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+
+        if (!rest.empty()) {
+            if (rest.front() != ',') return 1;
+            rest.remove_prefix(1);
+        }
+    }
+    return cpus.empty() ? 1 : 0;
+}
+
+int numaCpus(const unsigned int node, std::vector<int>& cpus) {
+    std::string filename = NUMA_NODE_PATH + std::to_string(node) + "/cpulist";
+    std::ifstream ifs(filename);
+    std::string list;
+    if (!ifs || !std::getline(ifs, list)) {
+        std::cerr << "NUMA node " << node << " is not found" << std::endl;
+        return 1;
+    }
+    return parseCpus(util::trim(list), cpus);
+}
+
+std::vector<int> availableCpus() {
+    std::vector<int> cpus;
+
+    cpu_set_t available;
+    if (sched_getaffinity(0, sizeof(available), &available) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &available)) cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+int pin(const int cpu) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+    if (err != 0) {
+        std::cerr << "failed to pin to CPU " << cpu << ": " << strerror(err)
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
+}  // namespace dns
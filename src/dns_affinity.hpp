@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define NUMA_NODE_PATH "/sys/devices/system/node/node"
+
+namespace dns {
+
+// parseCpus() reads a list of CPUs like "0-3,8,10-11" into cpus.
+int parseCpus(const std::string_view list, std::vector<int>& cpus);
+
+// numaCpus() appends the CPUs of the NUMA node, read from sysfs, so that
+// libnuma is not needed.
+int numaCpus(const unsigned int node, std::vector<int>& cpus);
+
+// availableCpus() returns the CPUs the process is allowed to run on.
+std::vector<int> availableCpus();
+
+// pin() binds the calling thread to the CPU. Memory it touches after that
+// comes from the NUMA node of the CPU by default.
+int pin(const int cpu);
+}  // namespace dns
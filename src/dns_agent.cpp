@@ -0,0 +1,364 @@
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <openssl/crypto.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+
+#include "./dns_agent.hpp"
+
+namespace dns {
+
+// results are copied as they are, like those of ProcessTester.
+static_assert(std::is_trivially_copyable_v<TestStats>);
+
+struct Header {
+    uint32_t magic;
+    uint32_t type;
+    uint64_t length;
+};
+
+static int writeAll(const int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 1;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int readAll(const int fd, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(fd, data, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 1;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int writeMessage(const int fd, const Message type, const std::string& payload) {
+    Header header{AGENT_MAGIC, static_cast<uint32_t>(type), payload.size()};
+    if (writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) ||
+        writeAll(fd, payload.data(), payload.size())) {
+        return 1;
+    }
+    return 0;
+}
+
+int setSilence(const int fd) {
+    struct timeval tv;
+    tv.tv_sec = AGENT_SILENCE / 1000;
+    tv.tv_usec = AGENT_SILENCE % 1000 * 1000;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0) {
+        perror("error on setsockopt()");
+        return 1;
+    }
+    return 0;
+}
+
+int readMessage(const int fd, Message& type, std::string& payload) {
+    Header header;
+    if (readAll(fd, reinterpret_cast<char*>(&header), sizeof(header))) {
+        return 1;
+    }
+    if (header.magic != AGENT_MAGIC || header.length > AGENT_MAX_MESSAGE) {
+        std::cerr << "message is malformed" << std::endl;
+        return 1;
+    }
+    type = static_cast<Message>(header.type);
+    payload.resize(header.length);
+    return readAll(fd, payload.data(), payload.size());
+}
+
+// PlanWriter and PlanReader lay fields out in the byte order of the host,
+// which is the same on both ends as results are raw TestStats anyway.
+struct PlanWriter {
+    std::string data;
+
+    template <typename T>
+    void put(const T value) {
+        data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void put(const std::string& value) {
+        put<uint64_t>(value.size());
+        data.append(value);
+    }
+};
+
+struct PlanReader {
+    const std::string& data;
+    size_t offset;
+    bool failed;
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (offset + sizeof(value) > data.size()) {
+            failed = true;
+            return value;
+        }
+        std::memcpy(&value, data.data() + offset, sizeof(value));
+        offset += sizeof(value);
+        return value;
+    }
+    std::string string() {
+        uint64_t len = get<uint64_t>();
+        if (failed || offset + len > data.size()) {
+            failed = true;
+            return "";
+        }
+        std::string value = data.substr(offset, len);
+        offset += len;
+        return value;
+    }
+};
+
+std::string encodePlan(const TestConfig& config, const std::string& token) {
+    PlanWriter plan;
+    plan.put<uint32_t>(AGENT_VERSION);
+    plan.put<uint64_t>(sizeof(TestStats));
+    plan.put(token);
+
+    plan.put(config.target);
+    plan.put<uint32_t>(config.query);
+    plan.put(config.corpus ? config.corpus->text() : std::string());
+    plan.put<uint8_t>(config.shuffle);
+    plan.put<uint32_t>(config.labels);
+    plan.put<double>(config.hitRatio);
+
+    plan.put(config.ns);
+    plan.put<uint32_t>(config.port);
+    plan.put<uint8_t>(config.recurse);
+    plan.put<uint8_t>(config.edns);
+
+    plan.put<uint32_t>(config.samples);
+    plan.put<uint32_t>(config.concurrency);
+    plan.put<uint32_t>(config.process);
+    plan.put<uint32_t>(config.processes);
+    plan.put<uint32_t>(config.sockets);
+    plan.put<uint32_t>(config.inflight);
+    plan.put<uint32_t>(config.batch);
+    plan.put<uint32_t>(config.transport);
+    plan.put(config.tlsName);
+
+    plan.put<int64_t>(config.timeout.count());
+    plan.put<uint32_t>(config.retries);
+    plan.put<double>(config.qps);
+
+    plan.put<uint32_t>(config.verify);
+    plan.put<uint32_t>(config.expected.size());
+    for (const std::string& data : config.expected) plan.put(data);
+
+    return std::move(plan.data);
+}
+
+int decodePlan(const std::string& data, const std::string& token,
+               TestConfig& config) {
+    PlanReader plan{data, 0, false};
+    if (plan.get<uint32_t>() != AGENT_VERSION ||
+        plan.get<uint64_t>() != sizeof(TestStats)) {
+        std::cerr << "plan is from another build" << std::endl;
+        return 1;
+    }
+    // the token is compared in constant time, so it can't be guessed from
+    // how long the refusal takes.
+    std::string secret = plan.string();
+    if (secret.size() != token.size() ||
+        CRYPTO_memcmp(secret.data(), token.data(), token.size()) != 0) {
+        std::cerr << "plan has a wrong token" << std::endl;
+        return 1;
+    }
+
+    config.target = plan.string();
+    config.query = static_cast<Type>(plan.get<uint32_t>());
+    std::string corpus = plan.string();
+    config.shuffle = plan.get<uint8_t>();
+    config.labels = static_cast<LabelMode>(plan.get<uint32_t>());
+    config.hitRatio = plan.get<double>();
+
+    config.ns = plan.string();
+    config.port = plan.get<uint32_t>();
+    config.recurse = plan.get<uint8_t>();
+    config.edns = plan.get<uint8_t>();
+
+    config.samples = plan.get<uint32_t>();
+    config.concurrency = plan.get<uint32_t>();
+    config.process = plan.get<uint32_t>();
+    config.processes = plan.get<uint32_t>();
+    config.sockets = plan.get<uint32_t>();
+    config.inflight = plan.get<uint32_t>();
+    config.batch = plan.get<uint32_t>();
+    config.transport = static_cast<Transport>(plan.get<uint32_t>());
+    config.tlsName = plan.string();
+
+    config.timeout = std::chrono::milliseconds(plan.get<int64_t>());
+    config.retries = plan.get<uint32_t>();
+    config.qps = plan.get<double>();
+
+    config.verify = plan.get<uint32_t>();
+    config.expected.clear();
+    uint32_t expected = plan.get<uint32_t>();
+    for (uint32_t i = 0; i < expected && !plan.failed; i++) {
+        config.expected.push_back(plan.string());
+    }
+
+    if (plan.failed || config.query >= TYPE_NUM || config.labels > SEQUENTIAL ||
+        config.transport > TLS || config.concurrency == 0 ||
+        config.processes == 0 || config.process >= config.processes) {
+        std::cerr << "plan is malformed" << std::endl;
+        return 1;
+    }
+
+    config.corpus.reset();
+    if (!corpus.empty()) {
+        config.corpus = std::make_shared<Corpus>();
+        if (config.corpus->assign(std::move(corpus))) return 1;
+    }
+
+    return 0;
+}
+
+Agent::Agent(const TestConfig& config, const std::string& token)
+    : config_(config), token_(token) {}
+
+int Agent::run(const std::string& address, const unsigned int port) {
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) <= 0) {
+        std::cerr << "agent address is invalid" << std::endl;
+        return 1;
+    }
+    // anyone who reaches the agent can make it send queries anywhere.
+    if ((ntohl(addr.sin_addr.s_addr) >> 24) != IN_LOOPBACKNET &&
+        token_.empty()) {
+        std::cerr << "an agent on " << address << " needs --agent_token"
+                  << std::endl;
+        return 1;
+    }
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("error on socket()");
+        return 1;
+    }
+
+    int on = 1;
+    if (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+        bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("error on bind()");
+        close(listener);
+        return 1;
+    }
+    if (listen(listener, SOMAXCONN) < 0) {
+        perror("error on listen()");
+        close(listener);
+        return 1;
+    }
+
+    // one plan at a time, so that tests don't share the host.
+    while (true) {
+        struct sockaddr_in peer;
+        socklen_t len = sizeof(peer);
+        int fd = accept(listener, (struct sockaddr*)&peer, &len);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("error on accept()");
+            close(listener);
+            return 1;
+        }
+
+        if (config_.verbose) {
+            char buf[INET_ADDRSTRLEN];
+            std::cerr << "plan from "
+                      << inet_ntop(AF_INET, &peer.sin_addr, buf, sizeof(buf))
+                      << std::endl;
+        }
+        // a controller which stops talking doesn't hold the agent.
+        if (setSilence(fd) == 0) serve(fd);
+        close(fd);
+    }
+}
+
+void Agent::serve(const int fd) {
+    Message type;
+    std::string payload;
+    if (readMessage(fd, type, payload) || type != Message::Plan) {
+        std::cerr << "failed to read plan" << std::endl;
+        return;
+    }
+
+    TestConfig config = config_;
+    if (decodePlan(payload, token_, config)) {
+        writeMessage(fd, Message::Error, "plan is not accepted");
+        return;
+    }
+
+    if (writeMessage(fd, Message::Ready, "") ||
+        readMessage(fd, type, payload) || type != Message::Start ||
+        payload.size() != sizeof(int64_t)) {
+        std::cerr << "controller is gone before start" << std::endl;
+        return;
+    }
+
+    // workers are launched during the delay before the start.
+    Tester tester(config);
+
+    // the start is on the wall clock shared with the controller, and the
+    // test runs on the monotonic clock.
+    int64_t at;
+    std::memcpy(&at, payload.data(), sizeof(at));
+    std::chrono::nanoseconds wait =
+        std::chrono::system_clock::time_point(std::chrono::nanoseconds(at)) -
+        std::chrono::system_clock::now();
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now() + std::max(wait, std::chrono::nanoseconds(0));
+    std::this_thread::sleep_until(start);
+
+    // the heartbeat lets the controller tell a long test from a lost agent.
+    // It stops before the result is written on the same connection.
+    std::mutex mtx;
+    std::condition_variable cond;
+    bool done = false;
+    std::thread heartbeat([&] {
+        std::unique_lock lock(mtx);
+        while (!cond.wait_for(lock, std::chrono::milliseconds(AGENT_HEARTBEAT),
+                              [&done] { return done; })) {
+            if (writeMessage(fd, Message::Progress, "")) break;
+        }
+    });
+
+    tester.run(start);
+
+    {
+        std::lock_guard lock(mtx);
+        done = true;
+    }
+    cond.notify_all();
+    heartbeat.join();
+
+    std::unique_ptr<TestStats> stats = tester.report();
+    std::string result;
+    if (stats) {
+        result.assign(reinterpret_cast<const char*>(stats.get()),
+                      sizeof(TestStats));
+    }
+    if (writeMessage(fd, Message::Result, result)) {
+        std::cerr << "failed to send result" << std::endl;
+    }
+}
+}  // namespace dns
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "./dns_tester.hpp"
+
+// first word of every message between the controller and agents.
+#define AGENT_MAGIC 0x444e5342
+// version of the messages. results are exchanged as raw TestStats, so the
+// size of TestStats has to match too, i.e. both run the same build.
+#define AGENT_VERSION 2
+// how long after the start message agents start in milliseconds, which
+// covers the time it takes to reach every agent.
+#define AGENT_START_DELAY 500
+// plans and results larger than this are refused.
+#define AGENT_MAX_MESSAGE (256 << 20)
+// how often a running agent tells the controller it's alive, and how long
+// either end waits for the other in milliseconds.
+#define AGENT_HEARTBEAT 1000
+#define AGENT_SILENCE 10000
+
+namespace dns {
+
+// messages between the controller and an agent, in order: the controller
+// sends the Plan, the agent answers Ready (or Error) when it accepted it,
+// the controller sends Start with the time to start at, and the agent sends
+// Progress every AGENT_HEARTBEAT while it runs, and its Result when the test
+// is done.
+enum class Message : uint32_t { Plan = 1, Ready, Start, Result, Error, Progress };
+
+// writeMessage() and readMessage() exchange one message over a blocking
+// socket, and return 1 when the connection failed or timed out.
+int writeMessage(const int fd, const Message type, const std::string& payload);
+int readMessage(const int fd, Message& type, std::string& payload);
+
+// setSilence() makes sends and receives on fd fail after AGENT_SILENCE.
+int setSilence(const int fd);
+
+// encodePlan() writes what an agent runs of config: the target, queries,
+// rate and samples, and its share of them as process of processes. Local
+// settings like CPUs, source ports and CA files are left to the agent.
+// token is the secret the agent shares with its controllers.
+std::string encodePlan(const TestConfig& config, const std::string& token);
+// decodePlan() overwrites the fields of config which are part of the plan,
+// and returns 1 when the plan is malformed, from another build or has
+// another token.
+int decodePlan(const std::string& plan, const std::string& token,
+               TestConfig& config);
+
+// Agent runs the plans of controllers one after another. Every plan runs
+// with the local settings of config. The token is sent in the clear, so it
+// keeps strangers from running plans on a trusted network, not more.
+class Agent {
+public:
+    Agent(const TestConfig& config, const std::string& token);
+
+    // run() listens on address:port and serves controllers until it fails.
+    // An address other than loopback needs a token.
+    int run(const std::string& address, const unsigned int port);
+
+private:
+    const TestConfig config_;
+    const std::string token_;
+
+    void serve(const int fd);
+};
+}  // namespace dns
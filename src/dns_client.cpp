@@ -1,9 +1,7 @@
-#include <sys/socket.h>
 #include <arpa/inet.h>
 #include <arpa/nameser.h>
 #include <arpa/nameser_compat.h>
 #include <netinet/in.h>
-#include <resolv.h>
 
 #include <iostream>
 #include <fstream>
@@ -53,156 +51,6 @@ std::vector<std::string> ConfigLoader::parseConf(const std::string& filename) {
     return servers;
 }
 
-Client::Client() {
-    ConfigLoader& confLoader = ConfigLoader::getInstance();
-    nss_ = confLoader.load();
-}
-
-Client::Client(const std::string ns) { nss_.push_back(ns); }
-
-int Client::resolv(const std::string dname, const Type type, const bool recurse,
-                   const bool edns, const bool wout,
-                   const unsigned int ntrials) {
-    return resolv(dname, DNS_PORT, type, recurse, edns, wout, ntrials);
-}
-
-// support UDP only.
-int Client::resolv(const std::string dname, const unsigned int port,
-                   const Type type, const bool recurse, const bool edns,
-                   const bool wout, const unsigned int ntrials) {
-    int sockfd;
-    struct sockaddr_in addr;
-
-    if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-        std::cerr << "socket is invalid" << std::endl;
-        return 1;
-    }
-
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-
-    std::string ns = nss_.front();
-    if (inet_pton(AF_INET, ns.c_str(), &addr.sin_addr) <= 0) {
-        std::cerr << "nameserver address is invalid" << std::endl;
-        shutdown(sockfd, SHUT_RDWR);
-        return 1;
-    }
-
-    if (connect(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        perror("error on connect()");
-        shutdown(sockfd, SHUT_RDWR);
-        return 1;
-    }
-
-    ns_type qtype;
-    switch (type) {
-        case AAAA:
-            qtype = ns_t_aaaa;
-            break;
-        case PTR:
-            qtype = ns_t_ptr;
-            break;
-        case CNAME:
-            qtype = ns_t_cname;
-            break;
-        case MX:
-            qtype = ns_t_mx;
-            break;
-        case TXT:
-            qtype = ns_t_txt;
-            break;
-        case NS:
-            qtype = ns_t_ns;
-            break;
-        case SOA:
-            qtype = ns_t_soa;
-            break;
-        case A:
-        default:
-            qtype = ns_t_a;
-            break;
-    }
-
-    res_state state = new __res_state;
-    state->options = RES_INIT;
-#ifndef NDEBUG
-    state->options |= RES_DEBUG;
-#endif
-
-    if (recurse) state->options |= RES_RECURSE;
-    if (edns) state->options |= RES_USE_EDNS0;
-
-    unsigned char query[DNS_BUFFER_SIZE];
-    size_t qlen;
-    if (qtype != ns_t_ptr) {
-#ifndef NDEBUG
-        util::debug("query => ", dname);
-#endif
-        qlen = res_nmkquery(state, ns_o_query, dname.c_str(), ns_c_in, qtype,
-                            nullptr, 0, nullptr, query, sizeof(query));
-        if (edns) qlen = res_nopt(state, qlen, query, sizeof(query), EDNS0_BUFFER_SIZE);
-    } else {
-        // Only IPv4 is supported for PTR query.
-        unsigned char tmp[INET_ADDRSTRLEN];
-        if (inet_pton(AF_INET, dname.c_str(), tmp) <= 0) {
-            std::cerr << "address is invalid" << std::endl;
-            shutdown(sockfd, SHUT_RDWR);
-            return 1;
-        }
-        std::string daddr = std::format("{:d}.{:d}.{:d}.{:d}.in-addr.arpa",
-                                        tmp[3], tmp[2], tmp[1], tmp[0]);
-#ifndef NDEBUG
-        util::debug("query => ", daddr);
-#endif
-        qlen = res_nmkquery(state, ns_o_query, daddr.c_str(), ns_c_in, qtype,
-                            nullptr, 0, nullptr, query, sizeof(query));
-        if (edns) qlen = res_nopt(state, qlen, query, sizeof(query), EDNS0_BUFFER_SIZE);
-    }
-
-    res_ndestroy(state);
-
-    ans_.clear();
-
-    for (int i = 0; i < ntrials; i++) {
-        std::chrono::system_clock::time_point start, end;
-
-        start = std::chrono::system_clock::now();
-
-        if (send(sockfd, query, qlen, 0) < 0) {
-            perror("error on send()");
-            continue;
-        }
-
-        unsigned char buffer[EDNS0_BUFFER_SIZE];
-        ssize_t length;
-        if ((length = recv(sockfd, buffer, sizeof(buffer) - 1, 0)) < 0) {
-            perror("error on recv()");
-            continue;
-        };
-
-        end = std::chrono::system_clock::now();
-
-        std::shared_ptr<Answer> ans = parse(buffer, length, end - start);
-
-        ans_.push_back(ans);
-
-        if (wout && print(ans)) {
-            std::cerr << "failed to print DNS answer" << std::endl;
-            continue;
-        }
-    }
-
-    shutdown(sockfd, SHUT_RDWR);
-
-    return 0;
-};
-
-std::shared_ptr<Answer> Client::answer() {
-    return !ans_.empty() ? ans_.front() : nullptr;
-}
-
-std::vector<std::shared_ptr<Answer>> Client::answers() { return ans_; }
-
 std::shared_ptr<Answer> Client::parse(
     const unsigned char* ans, const size_t alen,
     const std::chrono::duration<double, std::milli> elapsed) {
@@ -212,7 +60,8 @@ std::shared_ptr<Answer> Client::parse(
                /* count */ 1,
                /* records */ {},
                /* opt */ {},
-               /* metrics */ {/* elapsed */ elapsed, /* total */ alen}});
+               /* metrics */ {/* elapsed */ elapsed, /* total */ alen},
+               /* rcode */ 0, /* truncated */ false});
 
     answer->metrics.elapsed = elapsed;
     answer->metrics.total = alen;
@@ -221,13 +70,10 @@ std::shared_ptr<Answer> Client::parse(
 
     answer->authority = (bool)hp->aa;
     answer->recurse = (bool)hp->ra;
+    answer->rcode = hp->rcode;
+    answer->truncated = (bool)hp->tc;
 
-    if (hp->rcode) {
-        std::cerr << "failed to get answer: RCODE[" << hp->rcode << "]"
-                  << std::endl;
-        return answer;
-    } else if (hp->tc) {
-        std::cerr << "failed to get answer because of the size" << std::endl;
+    if (answer->rcode || answer->truncated) {
         return answer;
     }
 
@@ -403,7 +249,14 @@ std::shared_ptr<Answer> Client::parse(
 }
 
 int Client::print(const std::shared_ptr<Answer> ans) {
-    if (ans->status == Answer::Error) {
+    if (ans->rcode) {
+        std::cerr << "failed to get answer: RCODE[" << ans->rcode << "]"
+                  << std::endl;
+        return 0;
+    } else if (ans->truncated) {
+        std::cerr << "failed to get answer because of the size" << std::endl;
+        return 0;
+    } else if (ans->status == Answer::Error) {
         return 0;
     }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <netinet/in.h>
+
 #include <memory>
 #include <string>
 #include <vector>
@@ -24,6 +26,21 @@ enum Type {
     SOA,
 };
 
+// number of supported query types.
+const int TYPE_NUM = SOA + 1;
+
+enum Transport {
+    UDP,
+    TCP,
+    TLS,
+};
+
+// how the benchmark waits on its UDP sockets.
+enum Backend {
+    EPOLL,
+    IO_URING,
+};
+
 struct Answer {
     enum Status { Ok, Error };
 
@@ -59,6 +76,11 @@ struct Answer {
 
     // DNS metrics
     Metrics metrics;
+
+    // RCODE of the header, and whether the answer was truncated. Records
+    // are not decoded unless both are clear.
+    int rcode;
+    bool truncated;
 };
 
 class ConfigLoader {
@@ -80,28 +102,15 @@ private:
     std::vector<std::string> parseConf(const std::string& filename);
 };
 
+// Client decodes and prints answers. Queries are sent by Resolver, or by
+// Engine in bulk.
 class Client {
 public:
-    Client();
-    Client(const std::string ns);
-    int resolv(const std::string dname, const Type type = A,
-               const bool recurse = true, const bool edns = true,
-               const bool wout = true, const unsigned int ntrials = 1);
-    int resolv(const std::string dname, const unsigned int port,
-               const Type type = A, const bool recurse = true,
-               const bool edns = true, const bool wout = true,
-               const unsigned int ntrials = 1);
-    std::shared_ptr<Answer> answer();
-    std::vector<std::shared_ptr<Answer>> answers();
-
-private:
-    std::vector<std::string> nss_;
-    std::vector<std::shared_ptr<Answer>> ans_;
-
-    std::shared_ptr<Answer> parse(
+    static std::shared_ptr<Answer> parse(
         const unsigned char* ans, const size_t alen,
         const std::chrono::duration<double, std::milli> elapsed);
-
-    int print(const std::shared_ptr<Answer> ans);
+    // print() writes the answer as --check shows it, or why it's unusable
+    // (see Answer::status). It returns 1 only when printing failed.
+    static int print(const std::shared_ptr<Answer> ans);
 };
 }  // namespace dns
\ No newline at end of file
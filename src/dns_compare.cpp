@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <thread>
+
+#include "./dns_compare.hpp"
+
+namespace dns {
+
+CompareTester::CompareTester(const TestConfig& config,
+                             const std::vector<std::string>& servers)
+    : servers_(servers) {
+    for (unsigned int i = 0; i < servers_.size(); i++) {
+        TestConfig server = config;
+        server.ns = servers_[i];
+        server.server = i;
+        server.servers = servers_.size();
+        testers_.push_back(std::make_unique<Tester>(server));
+    }
+}
+
+void CompareTester::run() {
+    // every tester has set up its workers, so they start together.
+    for (std::unique_ptr<Tester>& tester : testers_) tester->ready();
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    std::vector<std::thread> runners;
+    for (std::unique_ptr<Tester>& tester : testers_) {
+        runners.emplace_back([&tester, start] { tester->run(start); });
+    }
+    for (std::thread& runner : runners) {
+        runner.join();
+    }
+}
+
+std::vector<CompareTester::Result> CompareTester::report() {
+    std::vector<Result> results;
+    for (unsigned int i = 0; i < testers_.size(); i++) {
+        results.push_back(Result{servers_[i], testers_[i]->report()});
+    }
+
+    auto failure = [](const Result& result) {
+        return static_cast<double>(result.stats->failure) /
+               result.stats->samples;
+    };
+    std::stable_sort(results.begin(), results.end(),
+                     [&failure](const Result& a, const Result& b) {
+                         if (!a.stats || !b.stats) return a.stats && !b.stats;
+                         if (failure(a) != failure(b)) {
+                             return failure(a) < failure(b);
+                         }
+                         return a.stats->percentile(50) <
+                                b.stats->percentile(50);
+                     });
+
+    return results;
+}
+}  // namespace dns
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+
+#include "./dns_tester.hpp"
+
+namespace dns {
+
+// CompareTester runs the same test against several name servers at the same
+// time, so that every server sees the same network conditions. Open-loop
+// schedules of the servers are interleaved with each other.
+class CompareTester {
+public:
+    struct Result {
+        std::string server;
+        // nullptr when the server never answered.
+        std::unique_ptr<TestStats> stats;
+    };
+
+    CompareTester(const TestConfig& config,
+                  const std::vector<std::string>& servers);
+
+    void run();
+
+    // report() returns the results ranked by failure rate, then by median
+    // answer time.
+    std::vector<Result> report();
+
+private:
+    std::vector<std::string> servers_;
+    std::vector<std::unique_ptr<Tester>> testers_;
+};
+}  // namespace dns
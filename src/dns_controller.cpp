@@ -0,0 +1,199 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <chrono>
+
+#include "./dns_controller.hpp"
+#include "./dns_agent.hpp"
+
+namespace dns {
+
+ControllerTester::ControllerTester(const TestConfig& config,
+                                   const std::vector<std::string>& agents,
+                                   const std::string& token)
+    : config_(config), agents_(agents), token_(token),
+      fds_(agents.size(), -1), results_(agents.size()) {}
+
+ControllerTester::~ControllerTester() {
+    for (int fd : fds_) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+int ControllerTester::connect(const std::string& agent) {
+    size_t colon = agent.rfind(':');
+    if (colon == std::string::npos || colon == 0) {
+        std::cerr << "agent is not host:port: " << agent << std::endl;
+        return -1;
+    }
+    std::string host = agent.substr(0, colon);
+    std::string port = agent.substr(colon + 1);
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* res;
+    int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+    if (err != 0) {
+        std::cerr << "failed to resolve " << agent << ": " << gai_strerror(err)
+                  << std::endl;
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai != nullptr; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+        perror("error on connect()");
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if (setSilence(fd)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void ControllerTester::fail(const unsigned int agent, const std::string& reason) {
+    std::cerr << "agent " << agents_[agent] << " " << reason << std::endl;
+    if (fds_[agent] >= 0) close(fds_[agent]);
+    fds_[agent] = -1;
+}
+
+int ControllerTester::run() {
+    unsigned int agents = agents_.size();
+    int status = 0;
+
+    // every agent takes its share of samples and rate, and its place in the
+    // schedule, like a process of ProcessTester.
+    for (unsigned int i = 0; i < agents; i++) {
+        TestConfig config = config_;
+        config.process = i;
+        config.processes = agents;
+        config.samples = config_.samples / agents +
+                         (i < config_.samples % agents ? 1 : 0);
+        config.qps = config_.qps / agents;
+
+        if ((fds_[i] = connect(agents_[i])) < 0) {
+            fail(i, "is not reachable");
+            status = 1;
+            continue;
+        }
+        if (writeMessage(fds_[i], Message::Plan, encodePlan(config, token_))) {
+            fail(i, "failed to take the plan");
+            status = 1;
+        }
+    }
+
+    Message type;
+    std::string payload;
+    for (unsigned int i = 0; i < agents; i++) {
+        if (fds_[i] < 0) continue;
+        type = Message::Plan;
+        if (readMessage(fds_[i], type, payload) || type != Message::Ready) {
+            fail(i, "refused the plan" +
+                        (type == Message::Error ? ": " + payload : ""));
+            status = 1;
+        }
+    }
+
+    // agents start on the wall clock, which is assumed to be synchronized
+    // between the hosts, e.g. by NTP.
+    std::chrono::system_clock::time_point at =
+        std::chrono::system_clock::now() +
+        std::chrono::milliseconds(AGENT_START_DELAY);
+    int64_t start = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        at.time_since_epoch())
+                        .count();
+    std::string message(reinterpret_cast<const char*>(&start), sizeof(start));
+    for (unsigned int i = 0; i < agents; i++) {
+        if (fds_[i] < 0) continue;
+        if (writeMessage(fds_[i], Message::Start, message)) {
+            fail(i, "failed to start");
+            status = 1;
+        }
+    }
+
+    // an open-loop test ends when its last query is sent and timed out,
+    // give or take AGENT_SILENCE. A closed-loop one is only bounded by the
+    // heartbeats of the agents.
+    std::chrono::system_clock::time_point deadline =
+        std::chrono::system_clock::time_point::max();
+    if (config_.qps > 0 && config_.timeout.count() > 0) {
+        deadline = at +
+                   std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::duration<double>(config_.samples /
+                                                     config_.qps)) +
+                   config_.timeout * (config_.retries + 1) +
+                   std::chrono::milliseconds(AGENT_SILENCE);
+    }
+
+    for (unsigned int i = 0; i < agents; i++) {
+        if (fds_[i] < 0) continue;
+        int failed;
+        type = Message::Plan;
+        do {
+            failed = readMessage(fds_[i], type, payload);
+        } while (!failed && type == Message::Progress &&
+                 std::chrono::system_clock::now() < deadline);
+        if (failed || type != Message::Result) {
+            fail(i, type == Message::Progress ? "did not finish in time"
+                                              : "failed to send its result");
+            status = 1;
+            continue;
+        }
+        // an empty result means no answer was received.
+        if (payload.size() == sizeof(TestStats)) {
+            results_[i] = std::make_unique<TestStats>();
+            std::memcpy(results_[i].get(), payload.data(), sizeof(TestStats));
+        } else if (!payload.empty()) {
+            fail(i, "sent a malformed result");
+            status = 1;
+        }
+        if (config_.verbose && results_[i]) {
+            std::cerr << "agent " << agents_[i] << ": " << results_[i]->success
+                      << " answered, " << results_[i]->failure << " failed"
+                      << std::endl;
+        }
+    }
+
+    return status;
+}
+
+std::unique_ptr<TestStats> ControllerTester::report() {
+    std::unique_ptr<TestStats> stats;
+
+    for (std::unique_ptr<TestStats>& result : results_) {
+        if (!result) continue;
+
+        if (!stats) {
+            stats = std::make_unique<TestStats>(*result);
+        } else {
+            stats->merge(*result);
+        }
+    }
+
+    return stats;
+}
+
+unsigned int ControllerTester::contributed() const {
+    return std::count_if(
+        results_.begin(), results_.end(),
+        [](const std::unique_ptr<TestStats>& result) { return result != nullptr; });
+}
+}  // namespace dns
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+
+#include "./dns_tester.hpp"
+
+namespace dns {
+
+// ControllerTester runs a test on agents on other hosts (or the same one),
+// like ProcessTester runs it on processes: every agent takes its share of
+// samples and rate, all start at the same time, and their results are merged
+// into one report.
+class ControllerTester {
+public:
+    // agents are given as host:port, and token is the secret they share.
+    ControllerTester(const TestConfig& config,
+                     const std::vector<std::string>& agents,
+                     const std::string& token);
+    ~ControllerTester();
+
+    // remove copy constructor
+    ControllerTester(ControllerTester const&) = delete;
+    void operator=(ControllerTester const&) = delete;
+
+    // run() returns 1 when an agent failed, which includes one silent for
+    // AGENT_SILENCE, or one still running well after an open-loop test
+    // should have ended. The results of the others are reported all the
+    // same.
+    int run();
+    std::unique_ptr<TestStats> report();
+    // contributed() returns the number of agents in the report.
+    unsigned int contributed() const;
+
+private:
+    const TestConfig config_;
+    const std::vector<std::string> agents_;
+    const std::string token_;
+
+    // connections to the agents, -1 for those which failed.
+    std::vector<int> fds_;
+    std::vector<std::unique_ptr<TestStats>> results_;
+
+    int connect(const std::string& agent);
+    void fail(const unsigned int agent, const std::string& reason);
+};
+}  // namespace dns
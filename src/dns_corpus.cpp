@@ -0,0 +1,113 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <cctype>
+
+#include "./dns_corpus.hpp"
+#include "./dns_query.hpp"
+#include "./utils.hpp"
+
+namespace dns {
+
+Corpus::Corpus() : map_(MAP_FAILED), length_(0) {}
+
+Corpus::~Corpus() {
+    if (map_ != MAP_FAILED) munmap(map_, length_);
+}
+
+int Corpus::load(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "failed to open " << filename << std::endl;
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        std::cerr << filename << " is empty" << std::endl;
+        close(fd);
+        return 1;
+    }
+
+    length_ = st.st_size;
+    map_ = mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map_ == MAP_FAILED) {
+        perror("error on mmap()");
+        return 1;
+    }
+    madvise(map_, length_, MADV_SEQUENTIAL);
+
+    const char* cp = static_cast<const char*>(map_);
+    return parse(cp, cp + length_, filename);
+}
+
+int Corpus::assign(std::string text) {
+    text_ = std::move(text);
+    return parse(text_.data(), text_.data() + text_.size(), "the plan");
+}
+
+std::string Corpus::text() const {
+    std::string text;
+    for (const Entry& entry : entries_) {
+        text.append(entry.name);
+        text += ' ';
+        text += typeName(entry.type);
+        text += '\n';
+    }
+    return text;
+}
+
+int Corpus::parse(const char* cp, const char* end, const std::string& source) {
+    auto blank = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+
+    size_t lineno = 0, skipped = 0;
+    while (cp < end) {
+        const char* eol = cp;
+        while (eol < end && *eol != '\n') eol++;
+        lineno++;
+
+        const char* p = cp;
+        cp = eol + 1;
+
+        while (p < eol && blank(*p)) p++;
+        if (p == eol || *p == '#' || *p == ';') continue;
+
+        const char* name = p;
+        while (p < eol && !blank(*p)) p++;
+        std::string_view dname(name, p - name);
+
+        while (p < eol && blank(*p)) p++;
+        const char* type = p;
+        while (p < eol && !blank(*p)) p++;
+        std::string_view tname(type, p - type);
+
+        // a line without type is an A query, as queryperf does.
+        Entry entry{dname, A};
+        if (!tname.empty() && parseType(tname, entry.type)) {
+#ifndef NDEBUG
+            util::debug("line #", lineno, " skipped: ", tname);
+#endif
+            skipped++;
+            continue;
+        }
+
+        entries_.push_back(entry);
+    }
+
+    if (skipped > 0) {
+        std::cerr << skipped << " queries with unsupported type are skipped"
+                  << std::endl;
+    }
+
+    if (entries_.empty()) {
+        std::cerr << "no query is found in " << source << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+}  // namespace dns
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./dns_client.hpp"
+
+namespace dns {
+
+// Corpus is a list of queries read from a queryperf/dnsperf style file with
+// one "name type" per line. The file is memory-mapped and names point into
+// the mapping, so it must stay alive while queries are built from it.
+class Corpus {
+public:
+    struct Entry {
+        std::string_view name;
+        Type type;
+    };
+
+    Corpus();
+    ~Corpus();
+
+    // remove copy constructor
+    Corpus(Corpus const&) = delete;
+    void operator=(Corpus const&) = delete;
+
+    int load(const std::string& filename);
+    // assign() reads the queries from text in the format of the file. The
+    // corpus keeps the text.
+    int assign(std::string text);
+    // text() returns the queries in the format of the file.
+    std::string text() const;
+
+    size_t size() const { return entries_.size(); }
+    const Entry& operator[](const size_t index) const {
+        return entries_[index];
+    }
+
+private:
+    void* map_;
+    size_t length_;
+
+    std::string text_;
+
+    std::vector<Entry> entries_;
+
+    int parse(const char* cp, const char* end, const std::string& source);
+};
+}  // namespace dns
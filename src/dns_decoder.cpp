@@ -0,0 +1,92 @@
+#include <arpa/nameser.h>
+
+#include "./dns_decoder.hpp"
+
+namespace dns {
+
+// skips a possibly compressed name and returns the position after it, or
+// nullptr if it runs past the end.
+static const unsigned char* skipName(const unsigned char* cp,
+                                     const unsigned char* end) {
+    while (cp < end) {
+        unsigned char n = *cp;
+        if (n == 0) return cp + 1;
+        // a compression pointer ends the name.
+        if ((n & NS_CMPRSFLGS) == NS_CMPRSFLGS) {
+            return cp + 2 <= end ? cp + 2 : nullptr;
+        }
+        if (n & NS_CMPRSFLGS) return nullptr;
+        cp += n + 1;
+    }
+    return nullptr;
+}
+
+int validate(const unsigned char* msg, const size_t len, Summary& summary) {
+    summary.status = Summary::Malformed;
+    summary.size = len;
+    summary.edns = false;
+
+    if (len < NS_HFIXEDSZ) return 1;
+
+    const unsigned char* cp = msg;
+    const unsigned char* end = msg + len;
+
+    summary.id = ns_get16(cp);
+    summary.authority = (cp[2] >> 2) & 1;
+    summary.truncated = (cp[2] >> 1) & 1;
+    summary.recurse = (cp[3] >> 7) & 1;
+    summary.rcode = cp[3] & 0x0f;
+    summary.qdcount = ns_get16(cp + 4);
+    summary.ancount = ns_get16(cp + 6);
+    summary.nscount = ns_get16(cp + 8);
+    summary.arcount = ns_get16(cp + 10);
+    cp += NS_HFIXEDSZ;
+
+    // a response without QR bit is not an answer.
+    if (!(msg[2] & 0x80)) return 1;
+
+    for (int i = 0; i < summary.qdcount; i++) {
+        if ((cp = skipName(cp, end)) == nullptr || cp + NS_QFIXEDSZ > end) {
+            return 1;
+        }
+        cp += NS_QFIXEDSZ;
+    }
+
+    int records = summary.ancount + summary.nscount + summary.arcount;
+    for (int i = 0; i < records; i++) {
+        const unsigned char* name = cp;
+        if ((cp = skipName(cp, end)) == nullptr || cp + NS_RRFIXEDSZ > end) {
+            return 1;
+        }
+
+        unsigned short type = ns_get16(cp);
+        unsigned short rdlen = ns_get16(cp + 8);
+        cp += NS_RRFIXEDSZ;
+        if (cp + rdlen > end) return 1;
+        cp += rdlen;
+
+        // OPT record in the Additional section on the root name.
+        if (type == ns_t_opt && i >= summary.ancount + summary.nscount &&
+            *name == 0) {
+            summary.edns = true;
+        }
+    }
+
+    if (summary.rcode != ns_r_noerror || summary.truncated) {
+        summary.status = Summary::Error;
+        return 1;
+    }
+
+    summary.status = Summary::Ok;
+
+    return 0;
+}
+
+const char* rcodeName(const unsigned short rcode) {
+    static const char* names[DNS_RCODE_NUM] = {
+        "NOERROR",  "FORMERR",  "SERVFAIL", "NXDOMAIN", "NOTIMP",  "REFUSED",
+        "YXDOMAIN", "YXRRSET",  "NXRRSET",  "NOTAUTH",  "NOTZONE", "DSOTYPENI",
+        "RCODE12",  "RCODE13",  "RCODE14",  "RCODE15"};
+    return names[rcode & 0x0f];
+}
+}  // namespace dns
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+// values of the 4-bit RCODE of the header.
+#define DNS_RCODE_NUM 16
+
+namespace dns {
+
+// Summary is what the benchmark needs to know about an answer. It's filled
+// by validate() straight from the receive buffer without any allocation.
+struct Summary {
+    enum Status { Ok, Error, Malformed };
+
+    Status status;
+
+    unsigned short id;
+    unsigned short rcode;
+
+    bool authority;
+    bool recurse;
+    bool truncated;
+    bool edns;
+
+    unsigned short qdcount;
+    unsigned short ancount;
+    unsigned short nscount;
+    unsigned short arcount;
+
+    size_t size;
+};
+
+// validate() checks the header and walks every section of msg to make sure
+// it's well-formed. Records are not decoded, use Client::parse() for that.
+// Returns 0 if the answer is usable (status is Ok).
+int validate(const unsigned char* msg, const size_t len, Summary& summary);
+
+// rcodeName() returns the mnemonic of a header RCODE.
+const char* rcodeName(const unsigned short rcode);
+}  // namespace dns
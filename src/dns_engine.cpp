@@ -0,0 +1,1304 @@
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <openssl/err.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <cerrno>
+#include <cctype>
+#include <random>
+#include <cstring>
+
+#include "./dns_engine.hpp"
+#include "./utils.hpp"
+
+namespace dns {
+
+// user_data of io_uring sends. receives carry the index of the socket.
+static constexpr uint64_t URING_TX = 1ULL << 63;
+
+// room for the control messages of one packet: a receive timestamp, or a
+// send timestamp with its extended error.
+static constexpr size_t CMSG_ROOM =
+    CMSG_SPACE(sizeof(struct scm_timestamping)) +
+    CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in));
+
+// kernel timestamps are taken with CLOCK_REALTIME. offset is the steady clock
+// minus the real time clock. The real time clock is read between two reads
+// of the steady clock, and again when they're far apart (e.g. preempted).
+static std::chrono::nanoseconds realtimeOffset() {
+    std::chrono::nanoseconds offset, window = std::chrono::nanoseconds::max();
+    for (int i = 0; i < 3; i++) {
+        std::chrono::steady_clock::time_point before =
+            std::chrono::steady_clock::now();
+        std::chrono::system_clock::time_point real =
+            std::chrono::system_clock::now();
+        std::chrono::steady_clock::time_point after =
+            std::chrono::steady_clock::now();
+        if (after - before < window) {
+            window = after - before;
+            offset = (before.time_since_epoch() + window / 2) -
+                     real.time_since_epoch();
+        }
+        if (window < std::chrono::microseconds(1)) break;
+    }
+    return offset;
+}
+
+static std::chrono::steady_clock::time_point steadyTime(
+    const struct timespec& ts, const std::chrono::nanoseconds offset) {
+    return std::chrono::steady_clock::time_point(
+        std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec) +
+        offset);
+}
+
+// rxTime() finds the kernel receive time of SO_TIMESTAMPNS or the software
+// one of SO_TIMESTAMPING among the control messages.
+static bool rxTime(struct msghdr* hdr, struct timespec& ts) {
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET) continue;
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return true;
+        } else if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            // software timestamps come first, hardware ones last.
+            std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return ts.tv_sec != 0 || ts.tv_nsec != 0;
+        }
+    }
+    return false;
+}
+
+// length of the question section of a message written by us (no compression).
+static size_t questionLength(const unsigned char* msg, const size_t len) {
+    size_t off = NS_HFIXEDSZ;
+    while (off < len && msg[off] != 0) {
+        off += msg[off] + 1;
+    }
+    off += 1 + NS_QFIXEDSZ;
+    return off <= len ? off - NS_HFIXEDSZ : 0;
+}
+
+Engine::Engine(const std::string ns, const unsigned int port,
+               const unsigned int sockets, const unsigned int batch,
+               const Transport transport)
+    : ns_(ns),
+      port_(port),
+      batch_(batch > 0 ? batch : 1),
+      transport_(transport),
+      epfd_(-1),
+      socks_(sockets > 0 ? sockets : 1),
+      cursor_(0),
+      inflight_(0),
+      stray_(0),
+      late_(0),
+      duplicates_(0),
+      timeouts_(0),
+      retries_(0),
+      errors_(0),
+      syscalls_(0),
+      connects_(0),
+      timeout_(0),
+      maxRetries_(0),
+      rxbuf_(std::max(batch_, (unsigned int)ENGINE_RECV_BURST) *
+             EDNS0_BUFFER_SIZE),
+      sourcePort_(0),
+      timestamps_(false),
+      requested_(EPOLL) {
+    std::random_device rd;
+    for (Socket& sock : socks_) {
+        sock.fd = -1;
+        sock.next = rd();
+        sock.inflight = 0;
+        sock.slots.resize(1 << 16);
+        sock.connecting = false;
+        sock.events = 0;
+        sock.woff = 0;
+        sock.rlen = 0;
+        sock.roff = 0;
+        sock.ssl = nullptr;
+        sock.handshaking = false;
+        sock.armed = false;
+        sock.port = 0;
+        sock.txseq = 0;
+        if (transport_ != UDP) {
+            // room for the largest message with its length.
+            sock.rbuf.resize(2 * (NS_INT16SZ + NS_MAXMSG));
+        } else if (batch_ > 1) {
+            sock.txbuf.resize(batch_ * DNS_BUFFER_SIZE);
+            sock.pending.reserve(batch_);
+            sock.lengths.reserve(batch_);
+        }
+    }
+    if (transport_ == UDP) {
+        size_t nbufs = rxbuf_.size() / EDNS0_BUFFER_SIZE;
+        cmsgbuf_.resize(nbufs * CMSG_ROOM);
+        msgs_.resize(nbufs);
+        iovs_.resize(nbufs);
+    }
+}
+
+void Engine::setTimeout(const std::chrono::milliseconds timeout,
+                        const unsigned int retries) {
+    timeout_ = timeout;
+    maxRetries_ = retries;
+}
+
+void Engine::setBackend(const Backend backend) { requested_ = backend; }
+
+void Engine::setSourcePort(const unsigned int port) { sourcePort_ = port; }
+
+void Engine::setTimestamps(const bool timestamps) { timestamps_ = timestamps; }
+
+void Engine::setTls(const std::string& name, const std::string& ca) {
+    tlsName_ = name;
+    tlsCa_ = ca;
+}
+
+Engine::~Engine() {
+    for (Socket& sock : socks_) {
+        if (sock.ssl != nullptr) SSL_free(sock.ssl);
+        if (sock.fd >= 0) close(sock.fd);
+    }
+    if (epfd_ >= 0) close(epfd_);
+}
+
+int Engine::open() {
+    struct sockaddr_in& addr = addr_;
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+
+    if (inet_pton(AF_INET, ns_.c_str(), &addr.sin_addr) <= 0) {
+        std::cerr << "nameserver address is invalid" << std::endl;
+        return 1;
+    }
+
+    if ((epfd_ = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        perror("error on epoll_create1()");
+        return 1;
+    }
+
+    timers_.start(std::chrono::steady_clock::now());
+
+    if (sourcePort_ > 0) {
+        if (sourcePort_ + socks_.size() - 1 > UINT16_MAX) {
+            std::cerr << "source ports are out of range" << std::endl;
+            return 1;
+        }
+        for (unsigned int i = 0; i < socks_.size(); i++) {
+            socks_[i].port = sourcePort_ + i;
+        }
+    }
+
+    if (transport_ != UDP) {
+        timestamps_ = false;
+        if (transport_ == TLS) {
+            tls_ = std::make_unique<TlsClient>();
+            if (tls_->open(tlsName_, tlsCa_)) return 1;
+        }
+
+        // wait for all connections, so that setup is not in the answer time.
+        std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() +
+            std::chrono::milliseconds(ENGINE_CONNECT_TIMEOUT);
+        std::vector<Response> responses;
+        auto wait = [&](const std::chrono::steady_clock::time_point until,
+                        auto done) {
+            while (!done()) {
+                std::chrono::nanoseconds timeout =
+                    until - std::chrono::steady_clock::now();
+                if (timeout.count() <= 0 || poll(timeout, responses)) break;
+            }
+        };
+        auto established = [this] {
+            return std::none_of(socks_.begin(), socks_.end(), [](Socket& sock) {
+                return sock.connecting || sock.handshaking;
+            });
+        };
+
+        // TLS 1.3 tickets come after the handshake, and are taken by reads.
+        size_t first = 0;
+        if (transport_ == TLS) {
+            if (connect(socks_[first++])) return 1;
+            wait(deadline, established);
+            wait(std::min(deadline,
+                          std::chrono::steady_clock::now() +
+                              std::chrono::milliseconds(ENGINE_TICKET_TIMEOUT)),
+                 [this] { return tls_->resumable(); });
+        }
+        for (size_t i = first; i < socks_.size(); i++) {
+            if (connect(socks_[i])) return 1;
+        }
+        wait(deadline, established);
+
+        for (Socket& sock : socks_) {
+            if (sock.fd < 0 || sock.connecting || sock.handshaking) {
+                std::cerr << "failed to connect to " << ns_ << std::endl;
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+    if (requested_ == IO_URING && openUring()) {
+        std::cerr << "io_uring is not available, falling back to epoll"
+                  << std::endl;
+        uring_.reset();
+    }
+    if (uring_) timestamps_ = false;
+
+    for (size_t i = 0; i < socks_.size(); i++) {
+        Socket& sock = socks_[i];
+
+        sock.fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sock.fd < 0) {
+            perror("error on socket()");
+            return 1;
+        }
+
+        if (bind(sock)) return 1;
+
+        if (::connect(sock.fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            perror("error on connect()");
+            return 1;
+        }
+
+        if (uring_) {
+            if (arm(i)) return 1;
+            continue;
+        }
+
+        // a batch drained by recvmmsg() shares one return time, so the kernel
+        // receive time of each packet is used instead.
+        if (timestamps_) {
+            int flags = SOF_TIMESTAMPING_SOFTWARE |
+                        SOF_TIMESTAMPING_RX_SOFTWARE |
+                        SOF_TIMESTAMPING_TX_SOFTWARE |
+                        SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+            if (setsockopt(sock.fd, SOL_SOCKET, SO_TIMESTAMPING, &flags,
+                           sizeof(flags)) < 0) {
+                perror("error on setsockopt()");
+                return 1;
+            }
+            sock.txids.resize(1 << 16);
+        } else if (batch_ > 1) {
+            int on = 1;
+            if (setsockopt(sock.fd, SOL_SOCKET, SO_TIMESTAMPNS, &on,
+                           sizeof(on)) < 0) {
+                perror("error on setsockopt()");
+                return 1;
+            }
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, sock.fd, &ev) < 0) {
+            perror("error on epoll_ctl()");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int Engine::send(unsigned char* query, const size_t qlen,
+                 const unsigned int tag) {
+    return send(query, qlen, std::chrono::steady_clock::now(), tag);
+}
+
+int Engine::send(unsigned char* query, const size_t qlen,
+                 const std::chrono::steady_clock::time_point scheduled,
+                 const unsigned int tag) {
+    size_t qdlen = questionLength(query, qlen);
+    if (qdlen == 0) {
+        std::cerr << "query is malformed" << std::endl;
+        return 1;
+    }
+
+    // pick the next socket which still has a free DNS ID.
+    Socket* sock = nullptr;
+    for (size_t i = 0; i < socks_.size(); i++) {
+        Socket& candidate = socks_[cursor_++ % socks_.size()];
+        if (candidate.inflight < candidate.slots.size()) {
+            sock = &candidate;
+            break;
+        }
+    }
+    // quietly, as the caller counts it, and an open-loop sender may hit it
+    // for every query while the target is behind.
+    if (sock == nullptr) return 1;
+
+    unsigned short id = sock->next;
+    while (sock->slots[id].state == Slot::Pending) id++;
+    sock->next = id + 1;
+
+    if (transport_ != UDP && sock->fd < 0 && connect(*sock)) return 1;
+
+    Slot& slot = sock->slots[id];
+    slot.generation++;
+    slot.tries = 0;
+    slot.query = query;
+    slot.qlen = qlen;
+    slot.qdlen = qdlen;
+    slot.tag = tag;
+    slot.scheduled = scheduled;
+    slot.stamped = false;
+
+    if (transmit(*sock, id)) return 1;
+
+    slot.state = Slot::Pending;
+
+    sock->inflight++;
+    inflight_++;
+
+    if (timeout_.count() > 0) {
+        uint64_t key = (uint64_t)slot.generation << 32 |
+                       (uint64_t)(sock - socks_.data()) << 16 | id;
+        timers_.schedule(key, slot.sent + timeout_);
+    }
+
+    // queries which fail to be sent are returned by poll().
+    if (sock->pending.size() >= batch_) flush(*sock);
+
+    return 0;
+}
+
+// transmit() sends (or queues) the query of the slot with its ID.
+int Engine::transmit(Socket& sock, const unsigned short id) {
+    Slot& slot = sock.slots[id];
+
+    if (transport_ != UDP) {
+        // frame the query with its length.
+        size_t off = sock.wbuf.size();
+        sock.wbuf.resize(off + NS_INT16SZ + slot.qlen);
+        unsigned char* buffer = sock.wbuf.data() + off;
+        ns_put16(slot.qlen, buffer);
+        std::copy(slot.query, slot.query + slot.qlen, buffer + NS_INT16SZ);
+        ns_put16(id, buffer + NS_INT16SZ);
+
+        sock.pending.push_back(id);
+
+        slot.sent = std::chrono::steady_clock::now();
+    } else if (uring_) {
+        // the query is copied, because its buffer is reused before the send
+        // is completed.
+        while (txfree_.empty()) {
+            if (submit(1, std::chrono::nanoseconds(-1))) return 1;
+        }
+        struct io_uring_sqe* sqe = uring_->sqe();
+        if (sqe == nullptr) {
+            if (submit(0, std::chrono::nanoseconds(0)) ||
+                (sqe = uring_->sqe()) == nullptr) {
+                return 1;
+            }
+        }
+
+        unsigned short tx = txfree_.back();
+        txfree_.pop_back();
+        unsigned char* buffer = txpool_.data() + tx * DNS_BUFFER_SIZE;
+        std::copy(slot.query, slot.query + slot.qlen, buffer);
+        ns_put16(id, buffer);
+
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = sock.fd;
+        sqe->addr = (uint64_t)buffer;
+        sqe->len = slot.qlen;
+        sqe->user_data = URING_TX | (uint64_t)tx << 32 |
+                         (uint64_t)(&sock - socks_.data()) << 16 | id;
+
+        slot.sent = std::chrono::steady_clock::now();
+    } else if (batch_ > 1) {
+        // a retry may find the queue full.
+        if (sock.pending.size() >= batch_) flush(sock);
+
+        // the caller reuses its buffer, so the query is copied with its ID.
+        unsigned char* buffer =
+            sock.txbuf.data() + sock.pending.size() * DNS_BUFFER_SIZE;
+        std::copy(slot.query, slot.query + slot.qlen, buffer);
+        ns_put16(id, buffer);
+
+        sock.pending.push_back(id);
+        sock.lengths.push_back(slot.qlen);
+
+        // flush() updates sent when the queue is actually sent.
+        slot.sent = std::chrono::steady_clock::now();
+    } else {
+        ns_put16(id, slot.query);
+
+        slot.sent = std::chrono::steady_clock::now();
+
+        syscalls_++;
+        if (::send(sock.fd, slot.query, slot.qlen, 0) < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("error on send()");
+            }
+            return 1;
+        }
+        if (timestamps_) sent(sock, id);
+    }
+
+    return 0;
+}
+
+// sent() numbers a datagram sent for the query of id, as the kernel numbers
+// its send timestamp.
+void Engine::sent(Socket& sock, const unsigned short id) {
+    Slot& slot = sock.slots[id];
+    slot.txseq = sock.txseq++;
+    slot.stamped = false;
+    sock.txids[slot.txseq & 0xffff] = id;
+}
+
+// stamp() reads the send timestamps from the error queue of the socket, and
+// replaces the send times of their queries with them. They're read in
+// batches, so that it doesn't take a syscall per query.
+int Engine::stamp(Socket& sock) {
+    size_t count = msgs_.size();
+    struct mmsghdr* msgs = msgs_.data();
+
+    while (true) {
+        for (size_t i = 0; i < count; i++) {
+            msgs[i].msg_hdr = {};
+            msgs[i].msg_hdr.msg_control = cmsgbuf_.data() + i * CMSG_ROOM;
+            msgs[i].msg_hdr.msg_controllen = CMSG_ROOM;
+        }
+
+        syscalls_++;
+        int n = recvmmsg(sock.fd, msgs, count, MSG_ERRQUEUE | MSG_DONTWAIT,
+                         nullptr);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("error on recvmmsg()");
+                return 1;
+            }
+            return 0;
+        }
+
+        std::chrono::nanoseconds offset = realtimeOffset();
+        for (int i = 0; i < n; i++) {
+            struct msghdr* hdr = &msgs[i].msg_hdr;
+            struct timespec ts = {};
+            struct sock_extended_err err = {};
+            for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg != nullptr;
+                 cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET &&
+                    cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                    std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                } else if (cmsg->cmsg_level == SOL_IP &&
+                           cmsg->cmsg_type == IP_RECVERR) {
+                    std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+                }
+            }
+            if (err.ee_origin != SO_EE_ORIGIN_TIMESTAMPING ||
+                err.ee_info != SCM_TSTAMP_SND || ts.tv_sec == 0) {
+                continue;
+            }
+
+            Slot& slot = sock.slots[sock.txids[err.ee_data & 0xffff]];
+            if (slot.state != Slot::Pending || slot.txseq != err.ee_data) {
+                continue;
+            }
+            slot.sent = steadyTime(ts, offset);
+            slot.stamped = true;
+        }
+
+        if (static_cast<size_t>(n) < count) return 0;
+    }
+}
+
+int Engine::openUring() {
+    uring_ = std::make_unique<Uring>();
+    if (uring_->open(ENGINE_URING_ENTRIES) ||
+        uring_->provide(0, ENGINE_URING_RX_BUFFERS, EDNS0_BUFFER_SIZE)) {
+        return 1;
+    }
+
+    txpool_.resize(ENGINE_URING_TX_BUFFERS * DNS_BUFFER_SIZE);
+    for (unsigned int i = 0; i < ENGINE_URING_TX_BUFFERS; i++) {
+        txfree_.push_back(i);
+    }
+    completions_.reserve(ENGINE_URING_RX_BUFFERS);
+    held_.reserve(ENGINE_URING_RX_BUFFERS);
+
+    return 0;
+}
+
+// arm() starts a multishot receive on the socket. It goes on until the
+// provided buffers run out.
+int Engine::arm(const unsigned int index) {
+    struct io_uring_sqe* sqe = uring_->sqe();
+    if (sqe == nullptr) return 1;
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = socks_[index].fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = index;
+
+    socks_[index].armed = true;
+
+    return 0;
+}
+
+// submit() submits the queued sends and receives of io_uring, and collects
+// the completions. Answers are kept in completions_ until poll() matches
+// them.
+int Engine::submit(const unsigned int wait,
+                   const std::chrono::nanoseconds timeout) {
+    syscalls_++;
+    if (uring_->submit(wait, timeout)) return 1;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    struct io_uring_cqe cqe;
+    while (uring_->next(cqe)) {
+        if (cqe.user_data & URING_TX) {
+            txfree_.push_back((cqe.user_data >> 32) & 0xffff);
+            if (cqe.res >= 0) continue;
+
+            // give the ID of the unsent query back.
+            Socket& sock = socks_[(cqe.user_data >> 16) & 0xffff];
+            unsigned short id = cqe.user_data & 0xffff;
+            if (sock.slots[id].state == Slot::Pending) giveUp(sock, id);
+            continue;
+        }
+
+        unsigned int index = cqe.user_data;
+        if (!(cqe.flags & IORING_CQE_F_MORE)) socks_[index].armed = false;
+        if (!(cqe.flags & IORING_CQE_F_BUFFER)) continue;
+
+        unsigned short bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        if (cqe.res <= 0) {
+            uring_->recycle(bid);
+            continue;
+        }
+        completions_.push_back(Completion{/* sock */ index,
+                                          /* bid */ bid,
+                                          /* length */ (size_t)cqe.res,
+                                          /* received */ now});
+    }
+
+    return 0;
+}
+
+int Engine::pollUring(const std::chrono::nanoseconds timeout,
+                      std::vector<Response>& responses) {
+    for (unsigned short bid : held_) {
+        uring_->recycle(bid);
+    }
+    held_.clear();
+
+    // receives stopped when the buffers ran out.
+    for (unsigned int i = 0; i < socks_.size(); i++) {
+        if (!socks_[i].armed && arm(i)) return 1;
+    }
+
+    // sends queued since the last poll() go with the same syscall.
+    if (submit(completions_.empty() ? 1 : 0, timeout)) return 1;
+
+    for (const Completion& completion : completions_) {
+        Response response;
+        if (match(socks_[completion.sock], uring_->buffer(completion.bid),
+                  completion.length, completion.received, response)) {
+            responses.push_back(response);
+            held_.push_back(completion.bid);
+        } else {
+            uring_->recycle(completion.bid);
+        }
+    }
+    completions_.clear();
+
+    return 0;
+}
+
+// expire() resends the queries whose timer expired, or gives them up as
+// timed out when no retry is left.
+void Engine::expire(std::vector<Response>& responses) {
+    expired_.clear();
+    timers_.advance(std::chrono::steady_clock::now(), expired_);
+
+    for (uint64_t key : expired_) {
+        Socket& sock = socks_[(key >> 16) & 0xffff];
+        unsigned short id = key & 0xffff;
+        Slot& slot = sock.slots[id];
+        if (slot.state != Slot::Pending || slot.generation != (key >> 32)) {
+            continue;
+        }
+
+        // TCP doesn't lose queries, so they are not resent.
+        if (transport_ == UDP && slot.tries < maxRetries_) {
+            slot.tries++;
+            retries_++;
+            if (transmit(sock, id) == 0) {
+                timers_.schedule(key, slot.sent + timeout_);
+                continue;
+            }
+        }
+
+        slot.state = Slot::Expired;
+        sock.inflight--;
+        inflight_--;
+        timeouts_++;
+
+        Response response;
+        response.data = nullptr;
+        response.length = 0;
+        response.tag = slot.tag;
+        response.timeout = true;
+        response.failed = false;
+        response.scheduled = slot.scheduled;
+        response.sent = slot.sent;
+        response.received = std::chrono::steady_clock::now();
+        response.stamped = false;
+        response.lag = std::chrono::nanoseconds(0);
+        responses.push_back(response);
+    }
+}
+
+int Engine::flush() {
+    if (uring_) return submit(0, std::chrono::nanoseconds(0));
+
+    int status = 0;
+    for (Socket& sock : socks_) {
+        if (!sock.pending.empty() && flush(sock)) status = 1;
+    }
+    return status;
+}
+
+int Engine::flush(Socket& sock) {
+    if (transport_ != UDP) {
+        // queries are written once the connection is established.
+        return sock.connecting || sock.handshaking ? 0 : writeStream(sock);
+    }
+
+    size_t count = sock.pending.size();
+
+    struct mmsghdr* msgs = msgs_.data();
+    struct iovec* iovs = iovs_.data();
+    for (size_t i = 0; i < count; i++) {
+        iovs[i].iov_base = sock.txbuf.data() + i * DNS_BUFFER_SIZE;
+        iovs[i].iov_len = sock.lengths[i];
+        msgs[i].msg_hdr = {};
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (unsigned short id : sock.pending) {
+        sock.slots[id].sent = now;
+    }
+
+    size_t done = 0;
+    while (done < count) {
+        syscalls_++;
+        int n = sendmmsg(sock.fd, msgs + done, count - done, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("error on sendmmsg()");
+            }
+            break;
+        }
+        if (timestamps_) {
+            for (int i = 0; i < n; i++) sent(sock, sock.pending[done + i]);
+        }
+        done += n;
+    }
+
+    // give the IDs of unsent queries back.
+    for (size_t i = done; i < count; i++) giveUp(sock, sock.pending[i]);
+
+    sock.pending.clear();
+    sock.lengths.clear();
+
+    return done < count ? 1 : 0;
+}
+
+int Engine::poll(const int timeout, std::vector<Response>& responses) {
+    return poll(std::chrono::milliseconds(timeout), responses);
+}
+
+int Engine::poll(const std::chrono::nanoseconds timeout,
+                 std::vector<Response>& responses) {
+    responses.clear();
+
+    // queries given up are returned after the answers, which take the
+    // receive buffers in order, and without waiting if there are some.
+    int status = receive(failed_.empty() ? timeout : std::chrono::nanoseconds(0),
+                         responses);
+    responses.insert(responses.end(), failed_.begin(), failed_.end());
+    failed_.clear();
+
+    return status;
+}
+
+int Engine::receive(const std::chrono::nanoseconds timeout,
+                    std::vector<Response>& responses) {
+    // answers returned by the last poll() are not referenced anymore.
+    if (transport_ != UDP) {
+        for (Socket& sock : socks_) {
+            if (sock.roff == 0) continue;
+            std::memmove(sock.rbuf.data(), sock.rbuf.data() + sock.roff,
+                         sock.rlen - sock.roff);
+            sock.rlen -= sock.roff;
+            sock.roff = 0;
+        }
+    }
+
+    if (!uring_) flush();
+
+    // don't sleep past the next query timeout.
+    std::chrono::nanoseconds wait = timeout;
+    if (timers_.size() > 0) {
+        auto until = std::max(timers_.next() - std::chrono::steady_clock::now(),
+                              std::chrono::steady_clock::duration::zero());
+        if (wait.count() < 0 || until < wait) {
+            wait = std::chrono::duration_cast<std::chrono::nanoseconds>(until);
+        }
+    }
+
+    if (uring_) {
+        if (pollUring(wait, responses)) return 1;
+        if (timers_.size() > 0) expire(responses);
+        return 0;
+    }
+
+    // epoll_pwait2() takes a timespec, so short waits of open-loop sending
+    // don't have to be rounded down to a busy loop.
+    struct timespec ts;
+    ts.tv_sec = wait.count() / 1000000000;
+    ts.tv_nsec = wait.count() % 1000000000;
+
+    struct epoll_event events[ENGINE_MAX_EVENTS];
+    syscalls_++;
+    int nfds = epoll_pwait2(epfd_, events, ENGINE_MAX_EVENTS,
+                            wait.count() < 0 ? nullptr : &ts, nullptr);
+    if (nfds < 0) {
+        if (errno == EINTR) return 0;
+        perror("error on epoll_pwait2()");
+        return 1;
+    }
+
+    size_t nbufs = rxbuf_.size() / EDNS0_BUFFER_SIZE;
+
+    // drain sockets while receive buffers are left. epoll is level
+    // triggered, so the rest is picked up by the next poll().
+    for (int i = 0; i < nfds; i++) {
+        Socket& sock = socks_[events[i].data.u32];
+        // send timestamps are read first, their answers may be waiting too.
+        if (timestamps_ && (events[i].events & EPOLLERR) && stamp(sock)) {
+            return 1;
+        }
+        if (transport_ != UDP) {
+            stream(sock, events[i].events, responses);
+        } else if (responses.size() >= nbufs) {
+            break;
+        } else if (batch_ > 1) {
+            drainBatch(sock, responses);
+        } else {
+            drain(sock, responses);
+        }
+    }
+
+    if (timers_.size() > 0) expire(responses);
+
+    return 0;
+}
+
+int Engine::drain(Socket& sock, std::vector<Response>& responses) {
+    size_t nbufs = rxbuf_.size() / EDNS0_BUFFER_SIZE;
+    // the clocks don't drift apart within one drain, like in drainBatch().
+    std::chrono::nanoseconds offset =
+        timestamps_ ? realtimeOffset() : std::chrono::nanoseconds(0);
+
+    while (responses.size() < nbufs) {
+        unsigned char* buffer =
+            rxbuf_.data() + responses.size() * EDNS0_BUFFER_SIZE;
+
+        struct iovec iov;
+        iov.iov_base = buffer;
+        iov.iov_len = EDNS0_BUFFER_SIZE;
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = cmsgbuf_.data();
+        msg.msg_controllen = CMSG_ROOM;
+
+        // the receive timestamp needs recvmsg().
+        syscalls_++;
+        ssize_t length = timestamps_
+                             ? recvmsg(sock.fd, &msg, MSG_DONTWAIT)
+                             : recv(sock.fd, buffer, EDNS0_BUFFER_SIZE,
+                                    MSG_DONTWAIT);
+        if (length < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("error on recv()");
+                return 1;
+            }
+            break;
+        }
+
+        std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point received = now;
+        struct timespec ts;
+        if (timestamps_ && rxTime(&msg, ts)) {
+            received = std::min(steadyTime(ts, offset), now);
+        }
+
+        Response response;
+        if (match(sock, buffer, length, received, response)) {
+            response.lag = now - received;
+            responses.push_back(response);
+        }
+    }
+
+    return 0;
+}
+
+int Engine::drainBatch(Socket& sock, std::vector<Response>& responses) {
+    size_t nbufs = rxbuf_.size() / EDNS0_BUFFER_SIZE;
+    size_t cmsglen = CMSG_ROOM;
+
+    while (responses.size() < nbufs) {
+        size_t base = responses.size();
+        size_t count = std::min((size_t)batch_, nbufs - base);
+
+        struct mmsghdr* msgs = msgs_.data();
+        struct iovec* iovs = iovs_.data();
+        for (size_t i = 0; i < count; i++) {
+            iovs[i].iov_base = rxbuf_.data() + (base + i) * EDNS0_BUFFER_SIZE;
+            iovs[i].iov_len = EDNS0_BUFFER_SIZE;
+            msgs[i].msg_hdr = {};
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = cmsgbuf_.data() + (base + i) * cmsglen;
+            msgs[i].msg_hdr.msg_controllen = cmsglen;
+        }
+
+        syscalls_++;
+        int n = recvmmsg(sock.fd, msgs, count, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("error on recvmmsg()");
+                return 1;
+            }
+            break;
+        }
+
+        std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        std::chrono::nanoseconds offset = realtimeOffset();
+
+        for (int i = 0; i < n; i++) {
+            std::chrono::steady_clock::time_point received = now;
+            struct timespec ts;
+            if (rxTime(&msgs[i].msg_hdr, ts)) {
+                received = std::min(steadyTime(ts, offset), now);
+            }
+
+            Response response;
+            if (match(sock, (unsigned char*)iovs[i].iov_base, msgs[i].msg_len,
+                      received, response)) {
+                response.lag = now - received;
+                // keep the answers packed at the front of the buffers.
+                if (responses.size() != base + i) {
+                    unsigned char* buffer = rxbuf_.data() +
+                                            responses.size() * EDNS0_BUFFER_SIZE;
+                    std::copy(response.data, response.data + response.length,
+                              buffer);
+                    response.data = buffer;
+                }
+                responses.push_back(response);
+            }
+        }
+
+        if (static_cast<size_t>(n) < count) break;
+    }
+
+    return 0;
+}
+
+// bind() binds the socket to its source port, if it has one.
+int Engine::bind(Socket& sock) {
+    if (sock.port == 0) return 0;
+
+    // a reconnecting TCP socket reuses its port from TIME_WAIT.
+    int on = 1;
+    setsockopt(sock.fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(sock.port);
+
+    if (::bind(sock.fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "failed to bind to port " << sock.port << ": "
+                  << strerror(errno) << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int Engine::connect(Socket& sock) {
+    sock.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock.fd < 0) {
+        perror("error on socket()");
+        return 1;
+    }
+
+    int on = 1;
+    setsockopt(sock.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    if (bind(sock)) {
+        close(sock.fd);
+        sock.fd = -1;
+        return 1;
+    }
+
+    sock.since = std::chrono::steady_clock::now();
+    sock.connecting = true;
+    sock.events = 0;
+
+    syscalls_++;
+    if (::connect(sock.fd, (struct sockaddr*)&addr_, sizeof(addr_)) < 0 &&
+        errno != EINPROGRESS) {
+        perror("error on connect()");
+        close(sock.fd);
+        sock.fd = -1;
+        sock.connecting = false;
+        return 1;
+    }
+
+    // completion of the connection is reported as writable.
+    return watch(sock, EPOLLIN | EPOLLOUT);
+}
+
+// handshake() drives the TLS handshake of the connection until it's done,
+// or it has to wait for the server.
+int Engine::handshake(Socket& sock) {
+    syscalls_++;
+    int ret = SSL_do_handshake(sock.ssl);
+    if (ret == 1) {
+        sock.handshaking = false;
+        std::chrono::nanoseconds elapsed =
+            std::chrono::steady_clock::now() - sock.since;
+        (SSL_session_reused(sock.ssl) ? resumption_ : full_)
+            .record(elapsed.count());
+        return 0;
+    }
+
+    switch (SSL_get_error(sock.ssl, ret)) {
+        case SSL_ERROR_WANT_READ:
+            return watch(sock, EPOLLIN);
+        case SSL_ERROR_WANT_WRITE:
+            return watch(sock, EPOLLIN | EPOLLOUT);
+        default:
+            std::cerr << "failed to establish TLS with " << ns_ << std::endl;
+            ERR_print_errors_fp(stderr);
+            disconnect(sock);
+            return 1;
+    }
+}
+
+// giveUp() frees the ID of a query which won't be answered, and keeps it for
+// poll() to return.
+void Engine::giveUp(Socket& sock, const unsigned short id) {
+    Slot& slot = sock.slots[id];
+    slot.state = Slot::Free;
+    sock.inflight--;
+    inflight_--;
+    errors_++;
+
+    Response response;
+    response.data = nullptr;
+    response.length = 0;
+    response.tag = slot.tag;
+    response.timeout = false;
+    response.failed = true;
+    response.scheduled = slot.scheduled;
+    response.sent = slot.sent;
+    response.received = std::chrono::steady_clock::now();
+    response.stamped = false;
+    response.lag = std::chrono::nanoseconds(0);
+    failed_.push_back(response);
+}
+
+// disconnect() closes the connection and gives up its queries.
+void Engine::disconnect(Socket& sock) {
+    if (sock.ssl != nullptr) {
+        SSL_free(sock.ssl);
+        sock.ssl = nullptr;
+    }
+    close(sock.fd);
+    sock.fd = -1;
+    sock.connecting = false;
+    sock.handshaking = false;
+    sock.events = 0;
+
+    for (size_t id = 0; id < sock.slots.size(); id++) {
+        if (sock.slots[id].state == Slot::Pending) giveUp(sock, id);
+    }
+
+    sock.pending.clear();
+    sock.wbuf.clear();
+    sock.woff = 0;
+    sock.rlen = 0;
+    sock.roff = 0;
+}
+
+int Engine::watch(Socket& sock, const uint32_t events) {
+    if (sock.events == events) return 0;
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.u32 = &sock - socks_.data();
+
+    int op = sock.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    syscalls_++;
+    if (epoll_ctl(epfd_, op, sock.fd, &ev) < 0) {
+        perror("error on epoll_ctl()");
+        return 1;
+    }
+    sock.events = events;
+
+    return 0;
+}
+
+int Engine::stream(Socket& sock, const uint32_t events,
+                   std::vector<Response>& responses) {
+    // the connection may be closed by an earlier event.
+    if (sock.fd < 0) return 0;
+
+    if (sock.connecting) {
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return 0;
+
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(sock.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            std::cerr << "error on connect(): " << std::strerror(err)
+                      << std::endl;
+            disconnect(sock);
+            return 1;
+        }
+
+        sock.connecting = false;
+        connects_++;
+        setup_.record(std::chrono::nanoseconds(
+                          std::chrono::steady_clock::now() - sock.since)
+                          .count());
+
+        if (transport_ == TLS) {
+            if ((sock.ssl = tls_->connect(sock.fd)) == nullptr) {
+                disconnect(sock);
+                return 1;
+            }
+            sock.handshaking = true;
+            sock.since = std::chrono::steady_clock::now();
+        }
+    }
+
+    // queries are held back until the handshake is done.
+    if (sock.handshaking) {
+        if (handshake(sock)) return 1;
+        if (sock.handshaking) return 0;
+    }
+
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        if (readStream(sock, responses)) return 1;
+    }
+
+    return writeStream(sock);
+}
+
+int Engine::readStream(Socket& sock, std::vector<Response>& responses) {
+    bool closed = false;
+
+    while (true) {
+        if (sock.rbuf.size() - sock.rlen < NS_INT16SZ + NS_MAXMSG) {
+            sock.rbuf.resize(sock.rbuf.size() * 2);
+        }
+
+        syscalls_++;
+        ssize_t n = readSome(sock, sock.rbuf.data() + sock.rlen,
+                             sock.rbuf.size() - sock.rlen);
+        if (n > 0) {
+            sock.rlen += n;
+            continue;
+        } else if (n == 0) {
+            closed = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror("error on recv()");
+            closed = true;
+        }
+        break;
+    }
+
+    // the buffer is not moved until the next poll(), so answers can point
+    // into it.
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while (sock.rlen - sock.roff >= NS_INT16SZ) {
+        const unsigned char* frame = sock.rbuf.data() + sock.roff;
+        size_t len = ns_get16(frame);
+        if (sock.rlen - sock.roff - NS_INT16SZ < len) break;
+
+        Response response;
+        if (match(sock, frame + NS_INT16SZ, len, now, response)) {
+            responses.push_back(response);
+        }
+        sock.roff += NS_INT16SZ + len;
+    }
+
+    if (closed) {
+        disconnect(sock);
+        return 1;
+    }
+
+    return 0;
+}
+
+int Engine::writeStream(Socket& sock) {
+    while (sock.woff < sock.wbuf.size()) {
+        syscalls_++;
+        ssize_t n = writeSome(sock, sock.wbuf.data() + sock.woff,
+                              sock.wbuf.size() - sock.woff);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            perror("error on send()");
+            disconnect(sock);
+            return 1;
+        }
+        sock.woff += n;
+    }
+
+    sock.pending.clear();
+
+    // wait for the connection to be writable while a part is left.
+    if (sock.woff < sock.wbuf.size()) {
+        return watch(sock, EPOLLIN | EPOLLOUT);
+    }
+
+    sock.wbuf.clear();
+    sock.woff = 0;
+
+    return watch(sock, EPOLLIN);
+}
+
+// TLS calls report what they wait for as EAGAIN, the end of the session as
+// 0 bytes, and failures as EPROTO.
+ssize_t Engine::readSome(Socket& sock, unsigned char* buf, const size_t len) {
+    if (sock.ssl == nullptr) return recv(sock.fd, buf, len, MSG_DONTWAIT);
+
+    errno = 0;
+    int n = SSL_read(sock.ssl, buf, len);
+    if (n > 0) return n;
+
+    switch (SSL_get_error(sock.ssl, n)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            errno = EAGAIN;
+            return -1;
+        case SSL_ERROR_ZERO_RETURN:
+            return 0;
+        case SSL_ERROR_SYSCALL:
+            return errno != 0 ? -1 : 0;
+        default:
+            ERR_print_errors_fp(stderr);
+            errno = EPROTO;
+            return -1;
+    }
+}
+
+ssize_t Engine::writeSome(Socket& sock, const unsigned char* buf,
+                          const size_t len) {
+    if (sock.ssl == nullptr) {
+        return ::send(sock.fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+
+    errno = 0;
+    int n = SSL_write(sock.ssl, buf, len);
+    if (n > 0) return n;
+
+    switch (SSL_get_error(sock.ssl, n)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            errno = EAGAIN;
+            return -1;
+        case SSL_ERROR_SYSCALL:
+            if (errno == 0) errno = EPIPE;
+            return -1;
+        default:
+            ERR_print_errors_fp(stderr);
+            errno = EPROTO;
+            return -1;
+    }
+}
+
+bool Engine::match(Socket& sock, const unsigned char* data, const size_t len,
+                   const std::chrono::steady_clock::time_point received,
+                   Response& response) {
+    if (len < NS_HFIXEDSZ || ns_get16(data + 4) != 1) {
+        stray_++;
+        return false;
+    }
+
+    Slot& slot = sock.slots[ns_get16(data)];
+    if (slot.state == Slot::Free || len < NS_HFIXEDSZ + slot.qdlen) {
+        stray_++;
+        return false;
+    }
+
+    // DNS names are case-insensitive and resolvers may randomize the case.
+    const unsigned char* q = slot.query + NS_HFIXEDSZ;
+    const unsigned char* r = data + NS_HFIXEDSZ;
+    for (size_t i = 0; i < slot.qdlen; i++) {
+        if (std::tolower(q[i]) != std::tolower(r[i])) {
+            stray_++;
+            return false;
+        }
+    }
+
+    // the ID is not in use, but the answer is for its last query.
+    if (slot.state == Slot::Expired) {
+        late_++;
+        return false;
+    } else if (slot.state == Slot::Answered) {
+        duplicates_++;
+        return false;
+    }
+
+    response.data = data;
+    response.length = len;
+    response.tag = slot.tag;
+    response.timeout = false;
+    response.failed = false;
+    response.scheduled = slot.scheduled;
+    response.sent = slot.sent;
+    response.stamped = slot.stamped;
+    response.lag = std::chrono::nanoseconds(0);
+    response.received = received;
+
+    slot.state = Slot::Answered;
+    sock.inflight--;
+    inflight_--;
+
+    return true;
+}
+}  // namespace dns
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+
+#include "./dns_client.hpp"
+#include "./dns_histogram.hpp"
+#include "./dns_timer.hpp"
+#include "./dns_uring.hpp"
+#include "./dns_tls.hpp"
+
+#define ENGINE_MAX_EVENTS 64
+#define ENGINE_RECV_BURST 64
+#define ENGINE_CONNECT_TIMEOUT 5000
+// how long open() waits for the session ticket of the first TLS connection.
+#define ENGINE_TICKET_TIMEOUT 100
+// io_uring submission entries, and buffers for sending and receiving.
+#define ENGINE_URING_ENTRIES 4096
+#define ENGINE_URING_TX_BUFFERS 4096
+#define ENGINE_URING_RX_BUFFERS 1024
+
+namespace dns {
+
+// Engine keeps many queries in flight over a few long-lived UDP sockets or
+// TCP connections. Responses are matched back to their queries by DNS ID and
+// question, so queries are pipelined on TCP connections too (RFC 7766), and
+// on TLS connections which are TCP connections with a TLS session (RFC 7858).
+class Engine {
+public:
+    struct Response {
+        const unsigned char* data;
+        size_t length;
+
+        // tag given to send() for the query.
+        unsigned int tag;
+
+        // no answer came within the timeout and retries. data is nullptr.
+        bool timeout;
+        // the query was given up without an answer, because it failed to be
+        // sent or its connection was closed. data is nullptr.
+        bool failed;
+
+        // scheduled is when the query was supposed to be sent. it equals
+        // sent unless the caller gave an explicit schedule.
+        std::chrono::steady_clock::time_point scheduled;
+        std::chrono::steady_clock::time_point sent;
+        std::chrono::steady_clock::time_point received;
+
+        // with timestamps, sent is when the kernel sent the query if stamped,
+        // and received is when the kernel received the answer. lag is how
+        // long the answer waited in the kernel before it was read.
+        bool stamped;
+        std::chrono::nanoseconds lag;
+    };
+
+    // with batch > 1 queries are queued and sent with sendmmsg(), and
+    // answers are drained with recvmmsg(), up to batch packets per syscall.
+    // Over TCP, batch queries are written to a connection at once.
+    Engine(const std::string ns, const unsigned int port = DNS_PORT,
+           const unsigned int sockets = 1, const unsigned int batch = 1,
+           const Transport transport = UDP);
+    ~Engine();
+
+    // remove copy constructor
+    Engine(Engine const&) = delete;
+    void operator=(Engine const&) = delete;
+
+    // setTimeout() gives up a query when it's not answered within timeout,
+    // after resending it retries times over UDP. 0 waits forever.
+    // It must be called before open().
+    void setTimeout(const std::chrono::milliseconds timeout,
+                    const unsigned int retries = 0);
+
+    // setBackend() selects io_uring for UDP sockets instead of epoll. Answers
+    // are received by multishot receives into provided buffers, and queries
+    // are submitted together at the next flush() or poll(). open() falls back
+    // to epoll when io_uring is not available. It must be called before
+    // open().
+    void setBackend(const Backend backend);
+    Backend backend() const { return uring_ ? IO_URING : EPOLL; }
+
+    // setSourcePort() binds the sockets to consecutive source ports from
+    // port, instead of ephemeral ones, so that their 5-tuples are known.
+    // It must be called before open().
+    void setSourcePort(const unsigned int port);
+
+    // setTimestamps() takes the send and receive times of UDP queries from
+    // the kernel (SO_TIMESTAMPING), so they leave out the time the engine
+    // takes to get to them. Send timestamps are read from the error queue,
+    // which costs a syscall per query. It applies to epoll only, and must be
+    // called before open().
+    void setTimestamps(const bool timestamps);
+
+    // setTls() verifies the certificate of the server for name, against the
+    // CA certificates of ca or the system ones. Without name any certificate
+    // is accepted. It must be called before open().
+    void setTls(const std::string& name, const std::string& ca);
+
+    // open() creates the sockets. TCP connections are established before
+    // it returns, and are re-established by send() when they are closed.
+    // Over TLS the first connection is established alone, so that the others
+    // resume its session, as re-established ones do.
+    int open();
+
+    // send() patches a free DNS ID into the query in place. The query buffer
+    // must stay alive until its response is returned by poll().
+    // In batch mode the query is copied and sent by flush() or poll().
+    // It returns 1 without a word when every DNS ID of every socket is in use.
+    int send(unsigned char* query, const size_t qlen,
+             const unsigned int tag = 0);
+    int send(unsigned char* query, const size_t qlen,
+             const std::chrono::steady_clock::time_point scheduled,
+             const unsigned int tag = 0);
+
+    int flush();
+
+    // poll() waits up to timeout milliseconds (or nanoseconds) and fills
+    // responses, including queries which timed out or were given up. A
+    // negative timeout waits forever, or until the next query times out.
+    // Response data is valid until the next call to poll().
+    int poll(const int timeout, std::vector<Response>& responses);
+    int poll(const std::chrono::nanoseconds timeout,
+             std::vector<Response>& responses);
+
+    // queries sent whose responses poll() has yet to return.
+    unsigned int inflight() const { return inflight_ + failed_.size(); }
+
+    // answers which don't belong to any query, which came after their query
+    // timed out, and which came for an already answered query.
+    unsigned long stray() const { return stray_; }
+    unsigned long late() const { return late_; }
+    unsigned long duplicates() const { return duplicates_; }
+
+    unsigned long timeouts() const { return timeouts_; }
+    unsigned long retries() const { return retries_; }
+    // queries which were given up, because they failed to be sent by
+    // flush() or their TCP connection was closed.
+    unsigned long errors() const { return errors_; }
+    unsigned long syscalls() const { return syscalls_; }
+
+    // TCP connections established and the time it took to establish them.
+    unsigned long connects() const { return connects_; }
+    const Histogram& setup() const { return setup_; }
+
+    // TLS handshakes which were full, and which resumed a session, and the
+    // time they took after the TCP connection was established.
+    const Histogram& fullHandshakes() const { return full_; }
+    const Histogram& resumedHandshakes() const { return resumption_; }
+
+private:
+    struct Slot {
+        // what happened to the last query which used the ID.
+        enum State { Free, Pending, Answered, Expired };
+
+        State state;
+        unsigned int generation;
+        unsigned int tries;
+
+        unsigned char* query;
+        size_t qlen;
+        size_t qdlen;
+        unsigned int tag;
+        std::chrono::steady_clock::time_point scheduled;
+        std::chrono::steady_clock::time_point sent;
+
+        // number of the last datagram sent for the query, and whether sent
+        // has been replaced with its kernel timestamp.
+        uint32_t txseq;
+        bool stamped;
+    };
+
+    struct Socket {
+        int fd;
+        unsigned short next;
+        unsigned int inflight;
+        std::vector<Slot> slots;
+
+        // queries waiting for flush() in batch mode.
+        std::vector<unsigned char> txbuf;
+        std::vector<unsigned short> pending;
+        std::vector<size_t> lengths;
+
+        // TCP connection. queries are framed into wbuf, and answers are read
+        // into rbuf which is compacted at the next poll().
+        bool connecting;
+        std::chrono::steady_clock::time_point since;
+        uint32_t events;
+        std::vector<unsigned char> wbuf;
+        size_t woff;
+        std::vector<unsigned char> rbuf;
+        size_t rlen;
+        size_t roff;
+
+        // TLS connection, and whether its handshake (started at since) is
+        // going on.
+        SSL* ssl;
+        bool handshaking;
+
+        // a multishot receive is running on the socket with io_uring.
+        bool armed;
+
+        // source port to bind to, or 0.
+        unsigned int port;
+
+        // datagrams sent, which is how the kernel numbers send timestamps,
+        // and the ID of the query of each of the last 65536.
+        uint32_t txseq;
+        std::vector<unsigned short> txids;
+    };
+
+    // an answer received by io_uring into a provided buffer.
+    struct Completion {
+        unsigned int sock;
+        unsigned short bid;
+        size_t length;
+        std::chrono::steady_clock::time_point received;
+    };
+
+    const std::string ns_;
+    const unsigned int port_;
+    const unsigned int batch_;
+    const Transport transport_;
+
+    struct sockaddr_in addr_;
+
+    int epfd_;
+    std::vector<Socket> socks_;
+    unsigned int cursor_;
+
+    unsigned int inflight_;
+    unsigned long stray_;
+    unsigned long late_;
+    unsigned long duplicates_;
+    unsigned long timeouts_;
+    unsigned long retries_;
+    unsigned long errors_;
+    unsigned long syscalls_;
+
+    // queries given up since the last poll().
+    std::vector<Response> failed_;
+
+    unsigned long connects_;
+    Histogram setup_;
+    Histogram full_;
+    Histogram resumption_;
+
+    std::chrono::milliseconds timeout_;
+    unsigned int maxRetries_;
+    TimerWheel timers_;
+    std::vector<uint64_t> expired_;
+
+    std::vector<unsigned char> rxbuf_;
+    std::vector<unsigned char> cmsgbuf_;
+    std::vector<struct mmsghdr> msgs_;
+    std::vector<struct iovec> iovs_;
+
+    unsigned int sourcePort_;
+    bool timestamps_;
+
+    std::unique_ptr<TlsClient> tls_;
+    std::string tlsName_;
+    std::string tlsCa_;
+
+    Backend requested_;
+    std::unique_ptr<Uring> uring_;
+    // queries are copied into txpool_ until their send is completed.
+    std::vector<unsigned char> txpool_;
+    std::vector<unsigned short> txfree_;
+    std::vector<Completion> completions_;
+    // buffers referenced by the responses of the last poll().
+    std::vector<unsigned short> held_;
+
+    int flush(Socket& sock);
+    int transmit(Socket& sock, const unsigned short id);
+    void expire(std::vector<Response>& responses);
+    int receive(const std::chrono::nanoseconds timeout,
+                std::vector<Response>& responses);
+    void giveUp(Socket& sock, const unsigned short id);
+    int drain(Socket& sock, std::vector<Response>& responses);
+    int drainBatch(Socket& sock, std::vector<Response>& responses);
+    void sent(Socket& sock, const unsigned short id);
+    int stamp(Socket& sock);
+
+    int openUring();
+    int arm(const unsigned int index);
+    int submit(const unsigned int wait, const std::chrono::nanoseconds timeout);
+    int pollUring(const std::chrono::nanoseconds timeout,
+                  std::vector<Response>& responses);
+
+    int bind(Socket& sock);
+    int connect(Socket& sock);
+    int handshake(Socket& sock);
+    void disconnect(Socket& sock);
+    int watch(Socket& sock, const uint32_t events);
+    int stream(Socket& sock, const uint32_t events,
+               std::vector<Response>& responses);
+    int readStream(Socket& sock, std::vector<Response>& responses);
+    int writeStream(Socket& sock);
+    // readSome() and writeSome() are recv() and send() of a connection, with
+    // or without TLS.
+    ssize_t readSome(Socket& sock, unsigned char* buf, const size_t len);
+    ssize_t writeSome(Socket& sock, const unsigned char* buf, const size_t len);
+
+    bool match(Socket& sock, const unsigned char* data, const size_t len,
+               const std::chrono::steady_clock::time_point received,
+               Response& response);
+};
+}  // namespace dns
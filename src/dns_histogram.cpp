@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cmath>
+
+#include "./dns_histogram.hpp"
+
+namespace dns {
+
+static constexpr uint64_t HALF = 1ULL << (HISTOGRAM_SUB_BITS - 1);
+static constexpr uint64_t LIMIT = (1ULL << HISTOGRAM_MAX_BITS) - 1;
+
+Histogram::Histogram() { reset(); }
+
+void Histogram::record(const uint64_t value) {
+    uint64_t v = std::min(value, LIMIT);
+
+    buckets_[index(v)]++;
+
+    count_++;
+    sum_ += v;
+    if (v < min_) min_ = v;
+    if (v > max_) max_ = v;
+}
+
+void Histogram::merge(const Histogram& other) {
+    if (other.count_ == 0) return;
+
+    for (size_t i = 0; i < buckets_.size(); i++) {
+        buckets_[i] += other.buckets_[i];
+    }
+
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+void Histogram::reset() {
+    count_ = 0;
+    sum_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+    buckets_.fill(0);
+}
+
+double Histogram::mean() const {
+    return count_ ? static_cast<double>(sum_) / count_ : 0.0;
+}
+
+uint64_t Histogram::percentile(const double p) const {
+    if (count_ == 0) return 0;
+
+    uint64_t rank = std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * count_);
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets_.size(); i++) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            return std::clamp(value(i), min_, max_);
+        }
+    }
+
+    return max_;
+}
+
+// values below 2 * HALF map to themselves. others keep their top
+// HISTOGRAM_SUB_BITS bits, shifted by (msb - HISTOGRAM_SUB_BITS + 1).
+size_t Histogram::index(const uint64_t value) {
+    if (value < 2 * HALF) return value;
+
+    unsigned int shift = 63 - __builtin_clzll(value) - (HISTOGRAM_SUB_BITS - 1);
+    return shift * HALF + (value >> shift);
+}
+
+// value() returns the middle of the range counted by the bucket.
+uint64_t Histogram::value(const size_t index) {
+    if (index < 2 * HALF) return index;
+
+    unsigned int shift = index / HALF - 1;
+    uint64_t sub = index - shift * HALF;
+    return (sub << shift) + ((1ULL << shift) >> 1);
+}
+}  // namespace dns
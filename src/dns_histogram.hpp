@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// values below 2^HISTOGRAM_SUB_BITS are counted exactly, larger ones with
+// 2^(HISTOGRAM_SUB_BITS - 1) buckets per power of two (< 0.4% error).
+#define HISTOGRAM_SUB_BITS 8
+// values are clamped below 2^HISTOGRAM_MAX_BITS (about 73 minutes in ns).
+#define HISTOGRAM_MAX_BITS 42
+#define HISTOGRAM_BUCKETS \
+    ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 2) << (HISTOGRAM_SUB_BITS - 1))
+
+namespace dns {
+
+// Histogram is a fixed-size log-linear histogram (HDR-like). It keeps no
+// pointers, so it can be copied around, merged and put into shared memory.
+class Histogram {
+public:
+    Histogram();
+
+    void record(const uint64_t value);
+    void merge(const Histogram& other);
+    void reset();
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const;
+
+    // percentile() returns the value at p (0 - 100) percent.
+    uint64_t percentile(const double p) const;
+
+private:
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+
+    std::array<uint64_t, HISTOGRAM_BUCKETS> buckets_;
+
+    static size_t index(const uint64_t value);
+    static uint64_t value(const size_t index);
+};
+}  // namespace dns
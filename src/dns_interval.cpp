@@ -0,0 +1,70 @@
+#include <iostream>
+#include <iomanip>
+
+#include "./dns_interval.hpp"
+
+namespace dns {
+
+void IntervalStats::merge(const IntervalStats& other) {
+    success += other.success;
+    failure += other.failure;
+    timeouts += other.timeouts;
+    latency.merge(other.latency);
+}
+
+IntervalWriter::IntervalWriter(const Format format)
+    : format_(format), out_(&std::cout), header_(false) {}
+
+int IntervalWriter::open(const std::string& filename) {
+    if (filename.empty()) return 0;
+
+    file_.open(filename, std::ios::out | std::ios::trunc);
+    if (!file_) {
+        std::cerr << "failed to open " << filename << std::endl;
+        return 1;
+    }
+    out_ = &file_;
+
+    return 0;
+}
+
+void IntervalWriter::write(const std::string& server,
+                           const IntervalStats& stats, const double time,
+                           const double duration) {
+    const Histogram& latency = stats.latency;
+    double qps = duration > 0 ? stats.success / duration : 0.0;
+
+    std::lock_guard lock(mtx_);
+
+    std::ostream& out = *out_;
+    out << std::fixed << std::setprecision(3);
+    if (format_ == CSV) {
+        if (!header_) {
+            out << "server,interval,time,duration,success,failure,timeouts,"
+                   "qps,avg_ms,p50_ms,p90_ms,p99_ms,p999_ms,max_ms"
+                << std::endl;
+            header_ = true;
+        }
+        out << server << "," << stats.index << "," << time << "," << duration
+            << "," << stats.success << "," << stats.failure << ","
+            << stats.timeouts << "," << qps << "," << latency.mean() / 1e6
+            << "," << latency.percentile(50) / 1e6 << ","
+            << latency.percentile(90) / 1e6 << ","
+            << latency.percentile(99) / 1e6 << ","
+            << latency.percentile(99.9) / 1e6 << "," << latency.max() / 1e6
+            << std::endl;
+    } else {
+        out << "{\"server\":\"" << server << "\",\"interval\":" << stats.index
+            << ",\"time\":" << time << ",\"duration\":" << duration
+            << ",\"success\":" << stats.success
+            << ",\"failure\":" << stats.failure
+            << ",\"timeouts\":" << stats.timeouts << ",\"qps\":" << qps
+            << ",\"avg_ms\":" << latency.mean() / 1e6
+            << ",\"p50_ms\":" << latency.percentile(50) / 1e6
+            << ",\"p90_ms\":" << latency.percentile(90) / 1e6
+            << ",\"p99_ms\":" << latency.percentile(99) / 1e6
+            << ",\"p999_ms\":" << latency.percentile(99.9) / 1e6
+            << ",\"max_ms\":" << latency.max() / 1e6 << "}" << std::endl;
+    }
+}
+}  // namespace dns
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <ostream>
+#include <mutex>
+#include <cstdint>
+
+#include "./dns_histogram.hpp"
+
+namespace dns {
+
+// IntervalStats are the results of one reporting interval.
+struct IntervalStats {
+    // number of the interval since the start of the test.
+    unsigned int index;
+    // the last interval of a worker, which may be cut short.
+    bool last;
+
+    uint64_t success;
+    uint64_t failure;
+    uint64_t timeouts;
+
+    // answer time in nanoseconds.
+    Histogram latency;
+
+    void merge(const IntervalStats& other);
+};
+
+// IntervalWriter prints interval snapshots as JSON Lines or CSV. Testers
+// running side by side may share one writer.
+class IntervalWriter {
+public:
+    enum Format { JSON, CSV };
+
+    IntervalWriter(const Format format);
+
+    // open() writes to filename, or to stdout when it's empty.
+    int open(const std::string& filename);
+
+    // write() prints the interval ending at time seconds after the start.
+    void write(const std::string& server, const IntervalStats& stats,
+               const double time, const double duration);
+
+private:
+    const Format format_;
+
+    std::mutex mtx_;
+    std::ofstream file_;
+    std::ostream* out_;
+    bool header_;
+};
+}  // namespace dns
@@ -0,0 +1,227 @@
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+#include <new>
+
+#include "./dns_metrics.hpp"
+
+namespace dns {
+
+static const uint64_t bounds[METRICS_BUCKETS] = METRICS_BOUNDS;
+
+void WorkerMetrics::record(const uint64_t elapsed) {
+    size_t i = std::lower_bound(bounds, bounds + METRICS_BUCKETS, elapsed) -
+               bounds;
+    bump(buckets[i]);
+    bump(sum, elapsed);
+}
+
+// label values escape backslashes, quotes and newlines.
+static std::string escape(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') escaped += '\\';
+        escaped += c == '\n' ? std::string("\\n") : std::string(1, c);
+    }
+    return escaped;
+}
+
+MetricsExporter::MetricsExporter(const std::vector<std::string>& servers,
+                                 const unsigned int workers)
+    : servers_(servers),
+      workers_(workers),
+      metrics_(nullptr),
+      length_(servers.size() * workers * sizeof(WorkerMetrics)),
+      listener_(-1),
+      stopped_(false) {}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+    if (listener_ >= 0) close(listener_);
+    if (metrics_ != nullptr) munmap(metrics_, length_);
+}
+
+int MetricsExporter::start(const unsigned int port) {
+    void* addr = mmap(nullptr, length_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        perror("error on mmap()");
+        return 1;
+    }
+    // the mapping is zero-filled, which is what the counters start from.
+    metrics_ = new (addr) WorkerMetrics[servers_.size() * workers_];
+
+    listener_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener_ < 0) {
+        perror("error on socket()");
+        return 1;
+    }
+
+    struct sockaddr_in sin;
+    std::memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int on = 1;
+    if (setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+        bind(listener_, (struct sockaddr*)&sin, sizeof(sin)) < 0) {
+        perror("error on bind()");
+        return 1;
+    }
+    if (listen(listener_, SOMAXCONN) < 0) {
+        perror("error on listen()");
+        return 1;
+    }
+
+    stopped_ = false;
+    thread_ = std::thread([this] { run(); });
+    return 0;
+}
+
+void MetricsExporter::stop() {
+    if (!thread_.joinable()) return;
+    stopped_ = true;
+    thread_.join();
+}
+
+WorkerMetrics& MetricsExporter::worker(const unsigned int server,
+                                       const unsigned int index) {
+    return metrics_[server * workers_ + index % workers_];
+}
+
+std::string MetricsExporter::render() const {
+    struct Series {
+        const char* name;
+        const char* help;
+        std::atomic<uint64_t> WorkerMetrics::*counter;
+    };
+    static const Series counters[] = {
+        {"dns_benchmark_queries_sent_total", "Queries sent.",
+         &WorkerMetrics::sent},
+        {"dns_benchmark_answers_total", "Queries answered without error.",
+         &WorkerMetrics::success},
+        {"dns_benchmark_failures_total",
+         "Queries failed, with an error RCODE or without answer.",
+         &WorkerMetrics::failure},
+        {"dns_benchmark_timeouts_total", "Queries given up without answer.",
+         &WorkerMetrics::timeouts},
+    };
+
+    std::ostringstream out;
+    // sums in seconds keep nanoseconds of long runs.
+    out << std::setprecision(15);
+    for (const Series& series : counters) {
+        out << "# HELP " << series.name << " " << series.help << "\n";
+        out << "# TYPE " << series.name << " counter\n";
+        for (size_t s = 0; s < servers_.size(); s++) {
+            uint64_t total = 0;
+            for (unsigned int i = 0; i < workers_; i++) {
+                total += (metrics_[s * workers_ + i].*series.counter)
+                             .load(std::memory_order_relaxed);
+            }
+            out << series.name << "{server=\"" << escape(servers_[s])
+                << "\"} " << total << "\n";
+        }
+    }
+
+    const char* name = "dns_benchmark_answer_seconds";
+    out << "# HELP " << name << " Answer time of the queries answered.\n";
+    out << "# TYPE " << name << " histogram\n";
+    for (size_t s = 0; s < servers_.size(); s++) {
+        std::array<uint64_t, METRICS_BUCKETS + 1> buckets{};
+        uint64_t sum = 0;
+        for (unsigned int i = 0; i < workers_; i++) {
+            const WorkerMetrics& worker = metrics_[s * workers_ + i];
+            for (int b = 0; b <= METRICS_BUCKETS; b++) {
+                buckets[b] += worker.buckets[b].load(std::memory_order_relaxed);
+            }
+            sum += worker.sum.load(std::memory_order_relaxed);
+        }
+
+        std::string server = escape(servers_[s]);
+        uint64_t count = 0;
+        for (int b = 0; b <= METRICS_BUCKETS; b++) {
+            count += buckets[b];
+            out << name << "_bucket{server=\"" << server << "\",le=\"";
+            if (b < METRICS_BUCKETS) {
+                out << bounds[b] / 1e9;
+            } else {
+                out << "+Inf";
+            }
+            out << "\"} " << count << "\n";
+        }
+        out << name << "_sum{server=\"" << server << "\"} " << sum / 1e9
+            << "\n";
+        out << name << "_count{server=\"" << server << "\"} " << count << "\n";
+    }
+
+    return out.str();
+}
+
+void MetricsExporter::run() {
+    while (!stopped_) {
+        struct pollfd pfd = {listener_, POLLIN, 0};
+        int n = poll(&pfd, 1, METRICS_NAP);
+        if (n < 0 && errno != EINTR) {
+            perror("error on poll()");
+            return;
+        }
+        if (n <= 0) continue;
+
+        int fd = accept(listener_, nullptr, nullptr);
+        if (fd < 0) continue;
+        serve(fd);
+        close(fd);
+    }
+}
+
+// serve() answers one request and closes the connection. Any path but
+// /metrics is not found.
+void MetricsExporter::serve(const int fd) {
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           request.size() < sizeof(buf) * 8) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, METRICS_REQUEST_TIMEOUT) <= 0) return;
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len <= 0) return;
+        request.append(buf, len);
+    }
+
+    std::string status = "200 OK";
+    std::string body;
+    if (request.rfind("GET /metrics ", 0) == 0 ||
+        request.rfind("GET /metrics?", 0) == 0) {
+        body = render();
+    } else if (request.rfind("GET ", 0) == 0) {
+        status = "404 Not Found";
+    } else {
+        status = "405 Method Not Allowed";
+    }
+
+    std::ostringstream response;
+    response << "HTTP/1.1 " << status << "\r\n"
+             << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+             << "Content-Length: " << body.size() << "\r\n"
+             << "Connection: close\r\n\r\n"
+             << body;
+    std::string data = response.str();
+    for (size_t off = 0; off < data.size();) {
+        ssize_t len = send(fd, data.data() + off, data.size() - off,
+                           MSG_NOSIGNAL);
+        if (len <= 0) return;
+        off += len;
+    }
+}
+}  // namespace dns
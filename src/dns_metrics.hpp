@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+// upper bounds of the answer time buckets in nanoseconds, from 50us to 5s.
+#define METRICS_BOUNDS                                                      \
+    {50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000,   \
+     25000000, 50000000, 100000000, 250000000, 500000000, 1000000000,      \
+     2500000000, 5000000000}
+#define METRICS_BUCKETS 16
+// how long the server waits for a request in milliseconds.
+#define METRICS_REQUEST_TIMEOUT 1000
+// how often the server checks whether it's stopped in milliseconds.
+#define METRICS_NAP 100
+
+namespace dns {
+
+// WorkerMetrics are the live counters of one worker. Only the worker writes
+// them, so they're bumped without a locked instruction, and the exporter
+// reads them while the test is running.
+struct alignas(64) WorkerMetrics {
+    std::atomic<uint64_t> sent;
+    std::atomic<uint64_t> success;
+    std::atomic<uint64_t> failure;
+    std::atomic<uint64_t> timeouts;
+
+    // answer times, counted in the first bucket they fit in, the last one
+    // for those above every bound. sum is in nanoseconds.
+    std::array<std::atomic<uint64_t>, METRICS_BUCKETS + 1> buckets;
+    std::atomic<uint64_t> sum;
+
+    static void bump(std::atomic<uint64_t>& counter, const uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n,
+                      std::memory_order_relaxed);
+    }
+
+    void record(const uint64_t elapsed);
+};
+
+// MetricsExporter serves the counters and answer times of the running test
+// over HTTP on localhost, in the Prometheus text format. The counters are
+// in memory shared with processes forked after it's created, so those of
+// ProcessTester are served too.
+class MetricsExporter {
+public:
+    // servers are the label values of the servers tested side by side, and
+    // workers the number of worker threads of each across processes.
+    MetricsExporter(const std::vector<std::string>& servers,
+                    const unsigned int workers);
+    ~MetricsExporter();
+
+    // remove copy constructor
+    MetricsExporter(MetricsExporter const&) = delete;
+    void operator=(MetricsExporter const&) = delete;
+
+    // start() sets up the counters, and serves scrapes on port of
+    // 127.0.0.1 on a thread until stop(). It must be called before the test
+    // starts.
+    int start(const unsigned int port);
+    void stop();
+
+    // worker() returns the counters of a worker. Runs testing the same
+    // server again, like the steps of --search, add to the same counters.
+    WorkerMetrics& worker(const unsigned int server, const unsigned int index);
+
+    // render() returns the current counters in the text format.
+    std::string render() const;
+
+private:
+    const std::vector<std::string> servers_;
+    const unsigned int workers_;
+
+    WorkerMetrics* metrics_;
+    size_t length_;
+
+    int listener_;
+    std::thread thread_;
+    std::atomic<bool> stopped_;
+
+    void run();
+    void serve(const int fd);
+};
+}  // namespace dns
@@ -0,0 +1,156 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <new>
+
+#include "./dns_process.hpp"
+#include "./dns_affinity.hpp"
+#include "./utils.hpp"
+
+namespace dns {
+
+ProcessTester::ProcessTester(const TestConfig& config,
+                             const unsigned int processes)
+    : config_(config),
+      processes_(processes > 0 ? processes : 1),
+      shared_(nullptr),
+      length_(sizeof(Shared) + processes_ * sizeof(Slot)) {}
+
+ProcessTester::~ProcessTester() {
+    if (shared_ != nullptr) munmap(shared_, length_);
+}
+
+int ProcessTester::run() {
+    void* addr = mmap(nullptr, length_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        perror("error on mmap()");
+        return 1;
+    }
+
+    shared_ = new (addr) Shared;
+    shared_->ready = 0;
+    shared_->go = false;
+    for (unsigned int i = 0; i < processes_; i++) {
+        new (&slot(i)) Slot;
+        slot(i).done = false;
+    }
+
+    // stdout is shared with the children.
+    std::cout.flush();
+
+    for (unsigned int i = 0; i < processes_; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("error on fork()");
+            break;
+        } else if (pid == 0) {
+            doTest(i);
+            _exit(0);
+        }
+        children_.push_back(pid);
+    }
+
+    // start all processes at once after their threads are launched. a child
+    // which died on the way is reported by waitpid() below.
+    while (shared_->ready < children_.size()) {
+        int wstatus;
+        pid_t pid = waitpid(-1, &wstatus, WNOHANG);
+        if (pid > 0) {
+            std::cerr << "process " << pid << " exited before start"
+                      << std::endl;
+            break;
+        }
+        usleep(100);
+    }
+    shared_->go = true;
+
+    int status = 0;
+    for (pid_t pid : children_) {
+        int wstatus;
+        if (waitpid(pid, &wstatus, 0) < 0 || !WIFEXITED(wstatus) ||
+            WEXITSTATUS(wstatus) != 0) {
+            std::cerr << "process " << pid << " exited abnormally" << std::endl;
+            status = 1;
+        }
+    }
+
+    return children_.size() == processes_ ? status : 1;
+}
+
+std::unique_ptr<TestStats> ProcessTester::report() {
+    std::unique_ptr<TestStats> stats;
+
+    for (unsigned int i = 0; i < processes_; i++) {
+        if (!slot(i).done) continue;
+
+        if (!stats) {
+            stats = std::make_unique<TestStats>(slot(i).stats);
+        } else {
+            stats->merge(slot(i).stats);
+        }
+    }
+
+    return stats;
+}
+
+unsigned int ProcessTester::contributed() const {
+    if (shared_ == nullptr) return 0;
+
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < processes_; i++) {
+        if (slot(i).done) count++;
+    }
+    return count;
+}
+
+void ProcessTester::doTest(const unsigned int process) {
+    // pin the process to its own cores. threads inherit the affinity, and
+    // are pinned to one of them each when the cores are given.
+    std::vector<int> cpus =
+        !config_.cpus.empty() ? config_.cpus : availableCpus();
+    if (!cpus.empty()) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (unsigned int i = 0; i < config_.concurrency; i++) {
+            CPU_SET(cpus[(process * config_.concurrency + i) % cpus.size()],
+                    &mask);
+        }
+        if (sched_setaffinity(0, sizeof(mask), &mask) < 0) {
+            perror("error on sched_setaffinity()");
+        }
+    }
+
+    // every process takes its share of samples and rate.
+    TestConfig config = config_;
+    config.process = process;
+    config.processes = processes_;
+    config.samples = config_.samples / processes_ +
+                     (process < config_.samples % processes_ ? 1 : 0);
+    config.qps = config_.qps / processes_;
+
+    // processes are ready once their engines are open.
+    Tester tester(config);
+    tester.ready();
+
+    shared_->ready++;
+    while (!shared_->go) {
+        usleep(10);
+    }
+
+    tester.run();
+
+    std::unique_ptr<TestStats> stats = tester.report();
+    if (stats) {
+        slot(process).stats = *stats;
+        slot(process).done = true;
+    }
+
+#ifndef NDEBUG
+    util::debug("process #", process, " - Done");
+#endif
+}
+}  // namespace dns
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <sys/types.h>
+
+#include "./dns_tester.hpp"
+
+namespace dns {
+
+// ProcessTester forks processes which run their own Tester pinned to
+// separate cores. Results are written into shared memory and merged by the
+// parent, so the processes share nothing while the test is running.
+class ProcessTester {
+public:
+    ProcessTester(const TestConfig& config, const unsigned int processes);
+    ~ProcessTester();
+
+    // remove copy constructor
+    ProcessTester(ProcessTester const&) = delete;
+    void operator=(ProcessTester const&) = delete;
+
+    // run() returns 1 when a process failed or could not be started. The
+    // results of the others are reported all the same.
+    int run();
+    std::unique_ptr<TestStats> report();
+    // contributed() returns the number of processes in the report.
+    unsigned int contributed() const;
+
+private:
+    struct Slot {
+        std::atomic<bool> done;
+        TestStats stats;
+    };
+
+    // slots of the processes follow Shared in the region.
+    struct Shared {
+        // processes which are ready to start, and the signal to start.
+        std::atomic<unsigned int> ready;
+        std::atomic<bool> go;
+    };
+
+    const TestConfig config_;
+    const unsigned int processes_;
+
+    Shared* shared_;
+    size_t length_;
+
+    std::vector<pid_t> children_;
+
+    Slot& slot(const unsigned int process) {
+        return reinterpret_cast<Slot*>(shared_ + 1)[process];
+    }
+    const Slot& slot(const unsigned int process) const {
+        return reinterpret_cast<const Slot*>(shared_ + 1)[process];
+    }
+
+    void doTest(const unsigned int process);
+};
+}  // namespace dns
@@ -0,0 +1,224 @@
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
+
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+
+#include "./dns_query.hpp"
+#include "./utils.hpp"
+
+namespace dns {
+
+unsigned short typeCode(const Type type) {
+    switch (type) {
+        case AAAA:
+            return ns_t_aaaa;
+        case PTR:
+            return ns_t_ptr;
+        case CNAME:
+            return ns_t_cname;
+        case MX:
+            return ns_t_mx;
+        case TXT:
+            return ns_t_txt;
+        case NS:
+            return ns_t_ns;
+        case SOA:
+            return ns_t_soa;
+        case A:
+        default:
+            return ns_t_a;
+    }
+}
+
+const char* typeName(const Type type) {
+    static const char* names[TYPE_NUM] = {"A",  "AAAA", "PTR", "CNAME",
+                                          "MX", "TXT",  "NS",  "SOA"};
+    return names[type];
+}
+
+int parseType(const std::string_view name, Type& type) {
+    for (int i = 0; i < TYPE_NUM; i++) {
+        std::string_view candidate = typeName(static_cast<Type>(i));
+        if (name.size() == candidate.size() &&
+            std::equal(name.begin(), name.end(), candidate.begin(),
+                       [](char a, char b) { return std::toupper(a) == b; })) {
+            type = static_cast<Type>(i);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// writes one label and returns the position after it, or nullptr.
+static unsigned char* putLabel(unsigned char* cp, const unsigned char* end,
+                               const std::string_view label) {
+    if (label.empty() || label.size() > NS_MAXLABEL ||
+        cp + 1 + label.size() > end) {
+        return nullptr;
+    }
+    *cp++ = label.size();
+    for (char c : label) *cp++ = c;
+    return cp;
+}
+
+// writes a.b.c.d.in-addr.arpa for an IPv4 address.
+static unsigned char* putReverse(unsigned char* cp, const unsigned char* end,
+                                 const unsigned char* addr) {
+    for (int i = 3; i >= 0; i--) {
+        char digits[3];
+        int n = 0;
+        unsigned int octet = addr[i];
+        do {
+            digits[2 - n++] = '0' + octet % 10;
+            octet /= 10;
+        } while (octet > 0);
+        cp = putLabel(cp, end, std::string_view(digits + 3 - n, n));
+        if (cp == nullptr) return nullptr;
+    }
+    if ((cp = putLabel(cp, end, "in-addr")) == nullptr) return nullptr;
+    return putLabel(cp, end, "arpa");
+}
+
+int encode(const std::string_view dname, const Type type, const bool recurse,
+           const bool edns, unsigned char* buf, const size_t buflen,
+           const unsigned int label) {
+    unsigned char* cp = buf;
+    const unsigned char* end = buf + buflen;
+
+    if (buflen < NS_HFIXEDSZ || label > QUERY_MAX_LABEL) return -1;
+
+    // header: ID is patched by the sender.
+    ns_put16(0, cp);
+    ns_put16(recurse ? 0x0100 : 0x0000, cp + 2);
+    ns_put16(1, cp + 4);
+    ns_put16(0, cp + 6);
+    ns_put16(0, cp + 8);
+    ns_put16(edns ? 1 : 0, cp + 10);
+    cp += NS_HFIXEDSZ;
+
+    if (label > 0) {
+        if (cp + 1 + label > end) return -1;
+        *cp++ = label;
+        std::fill(cp, cp + label, '0');
+        cp += label;
+    }
+
+    if (type == PTR) {
+        // Only IPv4 is supported for PTR query.
+        unsigned char addr[sizeof(struct in_addr)];
+        std::string ipv4(dname);
+        if (inet_pton(AF_INET, ipv4.c_str(), addr) <= 0) {
+            std::cerr << "address is invalid" << std::endl;
+            return -1;
+        }
+        cp = putReverse(cp, end, addr);
+    } else {
+        std::string_view rest = dname;
+        if (!rest.empty() && rest.back() == '.') rest.remove_suffix(1);
+        while (cp != nullptr && !rest.empty()) {
+            size_t dot = rest.find('.');
+            cp = putLabel(cp, end, rest.substr(0, dot));
+            rest = dot == std::string_view::npos ? std::string_view()
+                                                 : rest.substr(dot + 1);
+        }
+    }
+    if (cp == nullptr || cp + 1 + NS_QFIXEDSZ > end ||
+        cp + 1 - (buf + NS_HFIXEDSZ) > NS_MAXCDNAME) {
+        std::cerr << "domain name is invalid" << std::endl;
+        return -1;
+    }
+    *cp++ = 0;
+
+    ns_put16(typeCode(type), cp);
+    ns_put16(ns_c_in, cp + 2);
+    cp += NS_QFIXEDSZ;
+
+    if (edns) {
+        // OPT pseudo record on the root name.
+        if (cp + 1 + NS_RRFIXEDSZ > end) return -1;
+        *cp++ = 0;
+        ns_put16(ns_t_opt, cp);
+        ns_put16(EDNS0_BUFFER_SIZE, cp + 2);
+        ns_put32(0, cp + 4);
+        ns_put16(0, cp + 8);
+        cp += NS_RRFIXEDSZ;
+    }
+
+#ifndef NDEBUG
+    util::debug("query => ", dname);
+#endif
+
+    return cp - buf;
+}
+
+QueryArena::QueryArena() {}
+
+void QueryArena::reserve(const size_t queries, const size_t bytes) {
+    queries_.reserve(queries);
+    buffer_.reserve(bytes + DNS_BUFFER_SIZE);
+}
+
+int QueryArena::add(const std::string_view dname, const Type type,
+                    const bool recurse, const bool edns,
+                    const unsigned int label) {
+    size_t offset = buffer_.size();
+    buffer_.resize(offset + DNS_BUFFER_SIZE);
+
+    int length = encode(dname, type, recurse, edns, buffer_.data() + offset,
+                        DNS_BUFFER_SIZE, label);
+    if (length < 0) {
+        buffer_.resize(offset);
+        return -1;
+    }
+    buffer_.resize(offset + length);
+
+    queries_.push_back(Query{/* offset */ offset,
+                             /* length */ (size_t)length,
+                             /* label */ label,
+                             /* type */ type});
+
+    return queries_.size() - 1;
+}
+
+// writes value in base 32 into the label of width right after the header.
+// shifts are much cheaper than the divisions of base 36.
+static void putValue(unsigned char* query, const size_t width,
+                     uint64_t value) {
+    static const char digits[] = "0123456789abcdefghijklmnopqrstuv";
+
+    unsigned char* cp = query + NS_HFIXEDSZ + 1;
+    for (size_t i = width; i > 0; i--) {
+        cp[i - 1] = digits[value & 31];
+        value >>= 5;
+    }
+}
+
+void QueryArena::label(const size_t index, uint64_t value) {
+    const Query& query = queries_[index];
+    putValue(buffer_.data() + query.offset, query.label, value);
+}
+
+QueryPool::QueryPool(QueryArena& arena) : arena_(arena) {}
+
+unsigned int QueryPool::take(const size_t index, const uint64_t value) {
+    unsigned int handle;
+    if (!free_.empty()) {
+        handle = free_.back();
+        free_.pop_back();
+        indices_[handle] = index;
+    } else {
+        handle = buffers_.size();
+        buffers_.emplace_back();
+        indices_.push_back(index);
+    }
+
+    const QueryArena::Query& query = arena_.at(index);
+    unsigned char* buffer = buffers_[handle].data();
+    std::copy(arena_.data(index), arena_.data(index) + query.length, buffer);
+    if (query.label > 0) putValue(buffer, query.label, value);
+
+    return handle;
+}
+}  // namespace dns
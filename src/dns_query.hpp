@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <array>
+#include <cstdint>
+
+#include "./dns_client.hpp"
+
+// random labels are prepended to the name with this width at most.
+#define QUERY_MAX_LABEL 32
+// width of the unique labels of --label, 60 bits in base 32.
+#define QUERY_LABEL_WIDTH 12
+
+namespace dns {
+
+// what is prepended to the queried names. FIXED sends the names as they are,
+// the others a unique label per query so that it misses the resolver's
+// cache.
+enum LabelMode {
+    FIXED,
+    RANDOM,
+    SEQUENTIAL,
+};
+
+unsigned short typeCode(const Type type);
+const char* typeName(const Type type);
+// parseType() returns 0 and sets type if name (case-insensitive) is known.
+int parseType(const std::string_view name, Type& type);
+
+// encode() writes a query for dname into buf and returns its length, or -1
+// on error. The ID is left 0. A label of the given width is prepended to the
+// name when label > 0, see QueryArena::label().
+int encode(const std::string_view dname, const Type type, const bool recurse,
+           const bool edns, unsigned char* buf, const size_t buflen,
+           const unsigned int label = 0);
+
+// QueryArena keeps queries encoded once in one contiguous buffer. Senders
+// only rewrite the 16-bit ID (and optionally the label) in place.
+// Don't add() queries while others are in flight, since the buffer may move.
+class QueryArena {
+public:
+    struct Query {
+        size_t offset;
+        size_t length;
+        size_t label;
+        Type type;
+    };
+
+    QueryArena();
+
+    void reserve(const size_t queries, const size_t bytes);
+
+    // add() returns the index of the query, or -1 on error.
+    int add(const std::string_view dname, const Type type, const bool recurse,
+            const bool edns, const unsigned int label = 0);
+
+    size_t size() const { return queries_.size(); }
+    const Query& at(const size_t index) const { return queries_[index]; }
+    unsigned char* data(const size_t index) {
+        return buffer_.data() + queries_[index].offset;
+    }
+
+    // label() overwrites the label of the query with value in base 32.
+    void label(const size_t index, uint64_t value);
+
+private:
+    std::vector<unsigned char> buffer_;
+    std::vector<Query> queries_;
+};
+
+// QueryPool hands out private copies of arena queries, so that every query
+// in flight carries its own label. A copy is kept until it's released,
+// because the engine matches answers against it.
+class QueryPool {
+public:
+    QueryPool(QueryArena& arena);
+
+    // take() copies the query at index of the arena, writes value into its
+    // label if it has one, and returns the handle of the copy.
+    unsigned int take(const size_t index, const uint64_t value);
+    void release(const unsigned int handle) { free_.push_back(handle); }
+
+    unsigned char* data(const unsigned int handle) {
+        return buffers_[handle].data();
+    }
+    size_t length(const unsigned int handle) const {
+        return arena_.at(indices_[handle]).length;
+    }
+    // query() returns the index in the arena the copy was taken from.
+    size_t query(const unsigned int handle) const { return indices_[handle]; }
+
+private:
+    QueryArena& arena_;
+
+    // a deque keeps copies in place while it grows.
+    std::deque<std::array<unsigned char, DNS_BUFFER_SIZE>> buffers_;
+    std::vector<size_t> indices_;
+    std::vector<unsigned int> free_;
+};
+}  // namespace dns
@@ -0,0 +1,148 @@
+#include <arpa/nameser.h>
+
+#include "./dns_resolver.hpp"
+#include "./dns_query.hpp"
+
+namespace dns {
+
+Resolver::Lookup::Lookup(Resolver& resolver, const std::string_view name,
+                         const Type type)
+    : resolver_(resolver), name_(name), type_(type) {}
+
+// a lookup which can't be sent is not suspended, and resumes with nullptr.
+bool Resolver::Lookup::await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    return resolver_.submit(*this) == 0;
+}
+
+// the first name server of resolv.conf is used when ns is empty.
+static std::string nameserver(const std::string& ns) {
+    if (!ns.empty()) return ns;
+    std::vector<std::string> nss = ConfigLoader::getInstance().load();
+    return !nss.empty() ? nss.front() : "";
+}
+
+Resolver::Resolver(const std::string ns, const unsigned int port,
+                   const unsigned int sockets, const Transport transport)
+    : ns_(nameserver(ns)),
+      port_(port),
+      transport_(transport),
+      timeout_(0),
+      recurse_(true),
+      edns_(true),
+      engine_(std::make_unique<Engine>(ns_, port, sockets, 1, transport)),
+      pending_(0) {}
+
+void Resolver::setTimeout(const std::chrono::milliseconds timeout,
+                          const unsigned int retries) {
+    timeout_ = timeout;
+    engine_->setTimeout(timeout, retries);
+}
+
+void Resolver::setTls(const std::string& name, const std::string& ca) {
+    engine_->setTls(name, ca);
+}
+
+void Resolver::setFlags(const bool recurse, const bool edns) {
+    recurse_ = recurse;
+    edns_ = edns;
+}
+
+int Resolver::open() { return engine_->open(); }
+
+Resolver::Lookup Resolver::co_resolve(const std::string_view name,
+                                      const Type type) {
+    return Lookup(*this, name, type);
+}
+
+int Resolver::submit(Lookup& lookup) {
+    unsigned int tag;
+    if (!free_.empty()) {
+        tag = free_.back();
+        free_.pop_back();
+    } else {
+        tag = slots_.size();
+        slots_.emplace_back();
+    }
+
+    Slot& slot = slots_[tag];
+    slot.started = std::chrono::steady_clock::now();
+    int qlen = encode(lookup.name_, lookup.type_, recurse_, edns_,
+                      slot.query.data(), slot.query.size());
+    if (qlen < 0 || engine_->send(slot.query.data(), qlen, tag)) {
+        free_.push_back(tag);
+        return 1;
+    }
+    slot.qlen = qlen;
+    slot.lookup = &lookup;
+    pending_++;
+
+    return 0;
+}
+
+// retry() sends the query of a truncated answer again over TCP.
+int Resolver::retry(const unsigned int tag) {
+    if (!fallback_) {
+        fallback_ = std::make_unique<Engine>(ns_, port_, 1, 1, TCP);
+        fallback_->setTimeout(timeout_, 0);
+        if (fallback_->open()) {
+            fallback_.reset();
+            return 1;
+        }
+    }
+
+    Slot& slot = slots_[tag];
+    return fallback_->send(slot.query.data(), slot.qlen, tag);
+}
+
+void Resolver::complete(const Engine& engine, const Engine::Response& response,
+                        std::vector<Lookup*>& done) {
+    Slot& slot = slots_[response.tag];
+
+    std::shared_ptr<Answer> answer;
+    if (!response.timeout && !response.failed) {
+        bool truncated = response.length >= NS_HFIXEDSZ &&
+                         (response.data[2] & 0x02);
+        if (truncated && &engine == engine_.get() && transport_ == UDP &&
+            retry(response.tag) == 0) {
+            return;
+        }
+        answer = Client::parse(response.data, response.length,
+                               response.received - slot.started);
+    }
+
+    slot.lookup->answer_ = std::move(answer);
+    done.push_back(slot.lookup);
+    free_.push_back(response.tag);
+    pending_--;
+}
+
+int Resolver::run() {
+    std::vector<Engine::Response> responses;
+    std::vector<Lookup*> done;
+
+    while (pending_ > 0) {
+        bool udp = engine_->inflight() > 0;
+        bool tcp = fallback_ && fallback_->inflight() > 0;
+        if (!udp && !tcp) break;
+
+        for (Engine* engine : {engine_.get(), fallback_.get()}) {
+            if (engine == nullptr || engine->inflight() == 0) continue;
+            // both are polled in turn without sleeping long on either.
+            int timeout = -1;
+            if (udp && tcp) timeout = engine == engine_.get() ? RESOLVER_NAP : 0;
+            if (engine->poll(timeout, responses)) return 1;
+            for (const Engine::Response& response : responses) {
+                complete(*engine, response, done);
+            }
+        }
+
+        // coroutines are resumed once the answers are decoded, since they
+        // may send lookups of their own.
+        for (Lookup* lookup : done) lookup->handle_.resume();
+        done.clear();
+    }
+
+    return 0;
+}
+}  // namespace dns
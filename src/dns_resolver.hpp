@@ -0,0 +1,131 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <array>
+#include <chrono>
+
+#include "./dns_client.hpp"
+#include "./dns_engine.hpp"
+
+// how long run() waits on one engine in milliseconds, while queries are
+// outstanding on both the UDP and the fallback TCP engine.
+#define RESOLVER_NAP 1
+
+namespace dns {
+
+// Task is the return type of coroutines which await lookups. It starts
+// running when it's called, and frees its frame when it returns. Nothing
+// waits for it, so it must not throw.
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Resolver looks names up from coroutines: co_await co_resolve() sends the
+// query, and run() resumes the coroutine with the answer. Lookups share the
+// sockets and query buffers of one engine, so a lookup in flight costs its
+// coroutine frame and a buffer, not a thread. UDP answers which are
+// truncated are looked up again over TCP. It's owned by one thread.
+//
+//     dns::Task lookup(dns::Resolver& resolver) {
+//         std::shared_ptr<dns::Answer> answer =
+//             co_await resolver.co_resolve("www.example.com", dns::A);
+//         ...
+//     }
+//
+//     lookup(resolver);
+//     resolver.run();
+class Resolver {
+public:
+    // Lookup is what co_resolve() returns to be awaited. It resumes with the
+    // answer, or nullptr when no answer came.
+    class Lookup {
+    public:
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        std::shared_ptr<Answer> await_resume() { return std::move(answer_); }
+
+    private:
+        friend class Resolver;
+
+        Lookup(Resolver& resolver, const std::string_view name,
+               const Type type);
+
+        Resolver& resolver_;
+        std::string name_;
+        Type type_;
+
+        std::coroutine_handle<> handle_;
+        std::shared_ptr<Answer> answer_;
+    };
+
+    // the first name server of resolv.conf is used when ns is empty.
+    Resolver(const std::string ns, const unsigned int port = DNS_PORT,
+             const unsigned int sockets = 1, const Transport transport = UDP);
+
+    // remove copy constructor
+    Resolver(Resolver const&) = delete;
+    void operator=(Resolver const&) = delete;
+
+    // these are the same as those of Engine, and must be called before
+    // open().
+    void setTimeout(const std::chrono::milliseconds timeout,
+                    const unsigned int retries = 0);
+    void setTls(const std::string& name, const std::string& ca);
+    // setFlags() sets the RD bit and the EDNS0 record of the queries.
+    void setFlags(const bool recurse, const bool edns);
+
+    int open();
+
+    // co_resolve() looks name up when it's awaited.
+    Lookup co_resolve(const std::string_view name, const Type type = A);
+
+    // run() resumes the coroutines as their answers come, until no lookup
+    // is left. It returns 1 when the engine failed.
+    int run();
+
+    unsigned int pending() const { return pending_; }
+
+private:
+    // a lookup in flight. The engine refers to the query until it's done,
+    // so slots don't move.
+    struct Slot {
+        std::array<unsigned char, DNS_BUFFER_SIZE> query;
+        size_t qlen;
+        Lookup* lookup;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    const std::string ns_;
+    const unsigned int port_;
+    const Transport transport_;
+
+    std::chrono::milliseconds timeout_;
+    bool recurse_;
+    bool edns_;
+
+    std::unique_ptr<Engine> engine_;
+    // opened for the first truncated answer.
+    std::unique_ptr<Engine> fallback_;
+
+    std::deque<Slot> slots_;
+    std::vector<unsigned int> free_;
+    unsigned int pending_;
+
+    int submit(Lookup& lookup);
+    int retry(const unsigned int tag);
+    void complete(const Engine& engine, const Engine::Response& response,
+                  std::vector<Lookup*>& done);
+};
+}  // namespace dns
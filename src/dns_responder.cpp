@@ -0,0 +1,658 @@
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <cerrno>
+#include <cctype>
+#include <cstring>
+
+#include "./dns_responder.hpp"
+#include "./dns_query.hpp"
+#include "./utils.hpp"
+
+namespace dns {
+
+// appends name in wire format and lower case. returns false if it's invalid.
+static bool putName(std::string& out, std::string_view name) {
+    size_t start = out.size();
+    if (!name.empty() && name.back() == '.') name.remove_suffix(1);
+    while (!name.empty()) {
+        size_t dot = name.find('.');
+        std::string_view label = name.substr(0, dot);
+        if (label.empty() || label.size() > NS_MAXLABEL) return false;
+        out.push_back(label.size());
+        for (char c : label) {
+            out.push_back(std::tolower(static_cast<unsigned char>(c)));
+        }
+        name = dot == std::string_view::npos ? std::string_view()
+                                             : name.substr(dot + 1);
+    }
+    out.push_back(0);
+    return out.size() - start <= NS_MAXCDNAME;
+}
+
+static void putType(std::string& out, const unsigned short type) {
+    out.push_back(type >> 8);
+    out.push_back(type & 0xff);
+}
+
+Zone::Zone() {}
+
+int Zone::load(const std::string& filename) {
+    std::ifstream ifs(filename);
+    if (!ifs) {
+        std::cerr << "failed to open " << filename << std::endl;
+        return 1;
+    }
+
+    std::string line;
+    for (int lineno = 1; std::getline(ifs, line); lineno++) {
+        line = util::trim(line);
+        if (line.empty() || line.front() == '#' || line.front() == ';') {
+            continue;
+        }
+
+        std::istringstream iss(line);
+        std::string name, type, data;
+        iss >> name >> type;
+        std::getline(iss >> std::ws, data);
+
+        Type parsed;
+        std::string key, rdata;
+        bool valid = !data.empty() && parseType(type, parsed) == 0 &&
+                     putName(key, name);
+        if (valid) {
+            unsigned char addr[sizeof(struct in6_addr)];
+            switch (parsed) {
+                case A:
+                    valid = inet_pton(AF_INET, data.c_str(), addr) > 0;
+                    rdata.assign((char*)addr, sizeof(struct in_addr));
+                    break;
+                case AAAA:
+                    valid = inet_pton(AF_INET6, data.c_str(), addr) > 0;
+                    rdata.assign((char*)addr, sizeof(struct in6_addr));
+                    break;
+                case CNAME:
+                case NS:
+                case PTR:
+                    valid = putName(rdata, data);
+                    break;
+                case MX: {
+                    std::istringstream mx(data);
+                    unsigned int preference;
+                    std::string exchange;
+                    valid = (bool)(mx >> preference >> exchange);
+                    putType(rdata, preference);
+                    valid = valid && putName(rdata, exchange);
+                    break;
+                }
+                case TXT:
+                    if (data.size() >= 2 && data.front() == '"' &&
+                        data.back() == '"') {
+                        data = data.substr(1, data.size() - 2);
+                    }
+                    // character strings are 255 bytes at most.
+                    for (size_t i = 0; i < data.size() || i == 0; i += 255) {
+                        std::string_view chunk =
+                            std::string_view(data).substr(i, 255);
+                        rdata.push_back(chunk.size());
+                        rdata.append(chunk);
+                    }
+                    break;
+                default:
+                    valid = false;
+                    break;
+            }
+        }
+        if (!valid) {
+            std::cerr << filename << ":" << lineno << ": invalid record"
+                      << std::endl;
+            return 1;
+        }
+
+        names_.insert(key);
+        putType(key, typeCode(parsed));
+        records_[key].push_back(rdata);
+    }
+
+    return 0;
+}
+
+const std::vector<std::string>* Zone::find(const std::string_view key,
+                                           bool& exists) const {
+    auto iter = records_.find(key);
+    if (iter != records_.end()) {
+        exists = true;
+        return &iter->second;
+    }
+    exists = names_.find(key.substr(0, key.size() - NS_INT16SZ)) !=
+             names_.end();
+    return nullptr;
+}
+
+Responder::Responder(const ResponderConfig& config)
+    : config_(config), running_(false), failed_(false) {}
+
+int Responder::run() {
+    // the context is shared by the threads, so one certificate is made up.
+    if (config_.tlsPort > 0) {
+        tls_ = std::make_unique<TlsServer>();
+        if (tls_->open(config_.cert, config_.key)) return 1;
+    }
+
+    running_ = true;
+    failed_ = false;
+
+    std::vector<std::thread> pool;
+    for (unsigned int i = 0; i < std::max(config_.threads, 1U); i++) {
+        pool.emplace_back([this] { serve(); });
+    }
+    for (std::thread& worker : pool) {
+        worker.join();
+    }
+
+    return failed_ ? 1 : 0;
+}
+
+// open() binds the UDP socket and the TCP (and TLS) listeners of the worker.
+int Responder::open(Worker& worker) {
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config_.port);
+    if (inet_pton(AF_INET, config_.address.c_str(), &addr.sin_addr) <= 0) {
+        std::cerr << "address is invalid" << std::endl;
+        return 1;
+    }
+
+    int on = 1;
+    worker.udp = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    worker.listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (tls_) worker.tlsListener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    for (int fd : {worker.udp, worker.listener, worker.tlsListener}) {
+        if (fd == worker.tlsListener) {
+            if (!tls_) continue;
+            addr.sin_port = htons(config_.tlsPort);
+        }
+        if (fd < 0 ||
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+            setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0 ||
+            bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            perror("error on bind()");
+            return 1;
+        }
+        if (fd != worker.udp && listen(fd, SOMAXCONN) < 0) {
+            perror("error on listen()");
+            return 1;
+        }
+    }
+
+    if ((worker.epfd = epoll_create1(0)) < 0) {
+        perror("error on epoll_create1()");
+        return 1;
+    }
+    for (int fd : {worker.udp, worker.listener, worker.tlsListener}) {
+        if (fd < 0) continue;
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(worker.epfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            perror("error on epoll_ctl()");
+            return 1;
+        }
+    }
+
+    worker.rxbuf.resize(RESPONDER_BATCH * EDNS0_BUFFER_SIZE);
+    worker.txbuf.resize(RESPONDER_BATCH * EDNS0_BUFFER_SIZE);
+    worker.msgs.resize(RESPONDER_BATCH);
+    worker.replies.resize(RESPONDER_BATCH);
+    worker.iovs.resize(RESPONDER_BATCH);
+    worker.riovs.resize(RESPONDER_BATCH);
+    worker.addrs.resize(RESPONDER_BATCH);
+
+    return 0;
+}
+
+void Responder::serve() {
+    Worker worker;
+    worker.epfd = worker.udp = worker.listener = worker.tlsListener = -1;
+    worker.generation = 0;
+    if (open(worker)) {
+        release(worker);
+        // the other threads stop too, rather than serve a part of the port.
+        failed_ = true;
+        running_ = false;
+        return;
+    }
+
+    std::random_device rd;
+    std::mt19937_64 random(rd());
+
+    struct epoll_event events[RESPONDER_BATCH];
+    while (running_) {
+        // wake up for the next delayed answer, or now and then to see if
+        // the responder is stopped.
+        std::chrono::nanoseconds timeout = std::chrono::milliseconds(100);
+        if (!worker.delayed.empty()) {
+            timeout = std::clamp<std::chrono::nanoseconds>(
+                worker.delayed.front().due - std::chrono::steady_clock::now(),
+                std::chrono::nanoseconds(0), timeout);
+        }
+        struct timespec ts;
+        ts.tv_sec = timeout.count() / 1000000000;
+        ts.tv_nsec = timeout.count() % 1000000000;
+
+        int nfds = epoll_pwait2(worker.epfd, events, RESPONDER_BATCH, &ts,
+                                nullptr);
+        if (nfds < 0 && errno != EINTR) {
+            perror("error on epoll_pwait2()");
+            break;
+        }
+
+        for (int i = 0; i < nfds; i++) {
+            int fd = events[i].data.fd;
+            if (fd == worker.udp) {
+                receive(worker, random);
+            } else if (fd == worker.listener || fd == worker.tlsListener) {
+                accept(worker, fd);
+            } else {
+                stream(worker, fd, events[i].events, random);
+            }
+        }
+
+        // answers are delayed by the same time, so they're due in order.
+        std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        while (!worker.delayed.empty() && worker.delayed.front().due <= now) {
+            Delayed& delayed = worker.delayed.front();
+            if (delayed.fd < 0) {
+                sendto(worker.udp, delayed.data.data(), delayed.data.size(), 0,
+                       (struct sockaddr*)&delayed.addr, delayed.addrlen);
+            } else {
+                // answers of a closed connection aren't sent to one which
+                // got its fd since.
+                auto iter = worker.connections.find(delayed.fd);
+                if (iter != worker.connections.end() &&
+                    iter->second.generation == delayed.generation) {
+                    Connection& connection = iter->second;
+                    connection.wbuf.insert(connection.wbuf.end(),
+                                           delayed.data.begin(),
+                                           delayed.data.end());
+                    if (flush(worker, delayed.fd, connection)) {
+                        disconnect(worker, delayed.fd);
+                    }
+                }
+            }
+            worker.delayed.pop_front();
+        }
+    }
+
+    release(worker);
+}
+
+// receive() answers a batch of UDP queries with one sendmmsg().
+void Responder::receive(Worker& worker, std::mt19937_64& random) {
+    for (int i = 0; i < RESPONDER_BATCH; i++) {
+        worker.iovs[i].iov_base = worker.rxbuf.data() + i * EDNS0_BUFFER_SIZE;
+        worker.iovs[i].iov_len = EDNS0_BUFFER_SIZE;
+        std::memset(&worker.msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+        worker.msgs[i].msg_hdr.msg_iov = &worker.iovs[i];
+        worker.msgs[i].msg_hdr.msg_iovlen = 1;
+        worker.msgs[i].msg_hdr.msg_name = &worker.addrs[i];
+        worker.msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    }
+
+    int n = recvmmsg(worker.udp, worker.msgs.data(), RESPONDER_BATCH,
+                     MSG_DONTWAIT, nullptr);
+    if (n <= 0) return;
+
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned char* buf = worker.txbuf.data() + count * EDNS0_BUFFER_SIZE;
+        size_t len = answer(worker, (unsigned char*)worker.iovs[i].iov_base,
+                            worker.msgs[i].msg_len, buf, EDNS0_BUFFER_SIZE,
+                            true, random);
+        if (len == 0) continue;
+
+        if (config_.delay.count() > 0) {
+            worker.delayed.push_back(
+                Delayed{/* due */ std::chrono::steady_clock::now() +
+                            config_.delay,
+                        /* fd */ -1,
+                        /* generation */ 0,
+                        /* addr */ worker.addrs[i],
+                        /* addrlen */ worker.msgs[i].msg_hdr.msg_namelen,
+                        /* data */ {buf, buf + len}});
+            continue;
+        }
+
+        worker.riovs[count].iov_base = buf;
+        worker.riovs[count].iov_len = len;
+        std::memset(&worker.replies[count].msg_hdr, 0, sizeof(struct msghdr));
+        worker.replies[count].msg_hdr.msg_iov = &worker.riovs[count];
+        worker.replies[count].msg_hdr.msg_iovlen = 1;
+        worker.replies[count].msg_hdr.msg_name = &worker.addrs[i];
+        worker.replies[count].msg_hdr.msg_namelen =
+            worker.msgs[i].msg_hdr.msg_namelen;
+        count++;
+    }
+
+    if (count > 0 && sendmmsg(worker.udp, worker.replies.data(), count, 0) < 0) {
+        perror("error on sendmmsg()");
+    }
+}
+
+void Responder::accept(Worker& worker, const int listener) {
+    while (true) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("error on accept4()");
+            }
+            return;
+        }
+
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        SSL* ssl = nullptr;
+        if (listener == worker.tlsListener && (ssl = tls_->accept(fd)) == nullptr) {
+            close(fd);
+            continue;
+        }
+
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(worker.epfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            perror("error on epoll_ctl()");
+            SSL_free(ssl);
+            close(fd);
+            continue;
+        }
+        worker.connections[fd] = Connection{{}, {}, false, ssl, ssl != nullptr,
+                                            ++worker.generation};
+    }
+}
+
+// stream() reads the pipelined queries of a connection and answers them in
+// order.
+void Responder::stream(Worker& worker, const int fd, const uint32_t events,
+                       std::mt19937_64& random) {
+    auto iter = worker.connections.find(fd);
+    if (iter == worker.connections.end()) return;
+    Connection& connection = iter->second;
+
+    bool closed = events & (EPOLLERR | EPOLLHUP);
+    if (!closed && connection.handshaking) {
+        int ret = SSL_do_handshake(connection.ssl);
+        if (ret == 1) {
+            connection.handshaking = false;
+        } else {
+            int error = SSL_get_error(connection.ssl, ret);
+            closed = error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE;
+            if (!closed) return;
+        }
+    }
+    if (!closed && connection.ssl != nullptr) {
+        // OpenSSL keeps what it decrypted ahead, which epoll doesn't see, so
+        // it's read until it asks for more.
+        unsigned char chunk[EDNS0_BUFFER_SIZE];
+        while (true) {
+            int length = SSL_read(connection.ssl, chunk, sizeof(chunk));
+            if (length > 0) {
+                connection.rbuf.insert(connection.rbuf.end(), chunk,
+                                       chunk + length);
+                continue;
+            }
+            int error = SSL_get_error(connection.ssl, length);
+            closed = error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE;
+            ERR_clear_error();
+            break;
+        }
+    } else if (!closed && (events & EPOLLIN)) {
+        unsigned char chunk[EDNS0_BUFFER_SIZE];
+        ssize_t length = read(fd, chunk, sizeof(chunk));
+        if (length > 0) {
+            connection.rbuf.insert(connection.rbuf.end(), chunk,
+                                   chunk + length);
+        } else if (length == 0 ||
+                   (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            closed = true;
+        }
+    }
+
+    size_t off = 0;
+    unsigned char frame[NS_INT16SZ + NS_MAXMSG];
+    while (!closed && connection.rbuf.size() - off >= NS_INT16SZ) {
+        size_t qlen = ns_get16(connection.rbuf.data() + off);
+        if (connection.rbuf.size() - off < NS_INT16SZ + qlen) break;
+
+        size_t len = answer(worker, connection.rbuf.data() + off + NS_INT16SZ,
+                            qlen, frame + NS_INT16SZ, NS_MAXMSG, false, random);
+        off += NS_INT16SZ + qlen;
+        if (len == 0) continue;
+        ns_put16(len, frame);
+
+        if (config_.delay.count() > 0) {
+            worker.delayed.push_back(
+                Delayed{/* due */ std::chrono::steady_clock::now() +
+                            config_.delay,
+                        /* fd */ fd,
+                        /* generation */ connection.generation,
+                        /* addr */ {},
+                        /* addrlen */ 0,
+                        /* data */ {frame, frame + NS_INT16SZ + len}});
+        } else {
+            connection.wbuf.insert(connection.wbuf.end(), frame,
+                                   frame + NS_INT16SZ + len);
+        }
+    }
+    connection.rbuf.erase(connection.rbuf.begin(),
+                          connection.rbuf.begin() + off);
+
+    if (closed || flush(worker, fd, connection)) disconnect(worker, fd);
+}
+
+// flush() writes what it can of the answers, and waits for the connection
+// to be writable for the rest. returns 1 if the connection failed.
+int Responder::flush(Worker& worker, const int fd, Connection& connection) {
+    size_t off = 0;
+    while (off < connection.wbuf.size()) {
+        if (connection.ssl != nullptr) {
+            int length = SSL_write(connection.ssl, connection.wbuf.data() + off,
+                                   connection.wbuf.size() - off);
+            if (length > 0) {
+                off += length;
+                continue;
+            }
+            int error = SSL_get_error(connection.ssl, length);
+            ERR_clear_error();
+            if (error == SSL_ERROR_WANT_WRITE || error == SSL_ERROR_WANT_READ) {
+                break;
+            }
+            return 1;
+        }
+
+        ssize_t length = send(fd, connection.wbuf.data() + off,
+                              connection.wbuf.size() - off, MSG_NOSIGNAL);
+        if (length < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return 1;
+        }
+        off += length;
+    }
+    connection.wbuf.erase(connection.wbuf.begin(),
+                          connection.wbuf.begin() + off);
+
+    bool writing = !connection.wbuf.empty();
+    if (writing != connection.writing) {
+        struct epoll_event event;
+        event.events = writing ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(worker.epfd, EPOLL_CTL_MOD, fd, &event) < 0) {
+            perror("error on epoll_ctl()");
+            return 1;
+        }
+        connection.writing = writing;
+    }
+
+    return 0;
+}
+
+void Responder::disconnect(Worker& worker, const int fd) {
+    auto iter = worker.connections.find(fd);
+    if (iter == worker.connections.end()) return;
+
+    SSL_free(iter->second.ssl);
+    close(fd);
+    worker.connections.erase(iter);
+}
+
+void Responder::release(Worker& worker) {
+    for (auto& [fd, connection] : worker.connections) {
+        SSL_free(connection.ssl);
+        close(fd);
+    }
+    worker.connections.clear();
+
+    for (int fd : {worker.udp, worker.listener, worker.tlsListener, worker.epfd}) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+size_t Responder::answer(Worker& worker, const unsigned char* query,
+                         const size_t qlen, unsigned char* buf,
+                         const size_t buflen, const bool udp,
+                         std::mt19937_64& random) {
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    // answers and malformed queries are ignored.
+    if (qlen < NS_HFIXEDSZ || (query[2] & 0x80) || ns_get16(query + 4) != 1) {
+        return 0;
+    }
+    if (config_.drop > 0 && chance(random) < config_.drop) return 0;
+
+    // the question name is taken in lower case as the key of the zone.
+    const unsigned char* cp = query + NS_HFIXEDSZ;
+    const unsigned char* end = query + qlen;
+    std::string& key = worker.key;
+    key.clear();
+    while (cp < end && *cp != 0) {
+        unsigned int n = *cp;
+        if ((n & NS_CMPRSFLGS) || cp + 1 + n > end) return 0;
+        key.push_back(n);
+        for (unsigned int i = 1; i <= n; i++) {
+            key.push_back(std::tolower(static_cast<unsigned char>(cp[i])));
+        }
+        cp += n + 1;
+    }
+    if (cp + 1 + NS_QFIXEDSZ > end) return 0;
+    key.push_back(0);
+    cp++;
+    unsigned short qtype = ns_get16(cp);
+    putType(key, qtype);
+    cp += NS_QFIXEDSZ;
+
+    size_t question = cp - (query + NS_HFIXEDSZ);
+
+    // an OPT record right after the question tells the UDP payload size.
+    bool edns = false;
+    size_t limit = udp ? NS_PACKETSZ : buflen;
+    if (ns_get16(query + 10) > 0 && cp + 1 + NS_RRFIXEDSZ <= end && *cp == 0 &&
+        ns_get16(cp + 1) == ns_t_opt) {
+        edns = true;
+        if (udp) limit = std::max<size_t>(ns_get16(cp + 3), NS_PACKETSZ);
+    }
+    limit = std::min(limit, buflen);
+    size_t reserve = edns ? 1 + NS_RRFIXEDSZ : 0;
+    if (NS_HFIXEDSZ + question + reserve > limit) return 0;
+
+    // answers of a name without a zone are made up.
+    static const unsigned char v4[] = {127, 0, 0, 1};
+    static const unsigned char v6[] = {0, 0, 0, 0, 0, 0, 0, 0,
+                                       0, 0, 0, 0, 0, 0, 0, 1};
+    const std::vector<std::string>* records = nullptr;
+    bool exists = true;
+    if (config_.zone && !config_.zone->empty()) {
+        records = config_.zone->find(key, exists);
+    }
+
+    unsigned char* wp = buf;
+    std::copy(query, query + 4, wp);
+    // QR and AA on, RA follows RD, and the opcode is kept.
+    wp[2] = 0x80 | (query[2] & 0x79) | 0x04;
+    wp[3] = (query[2] & 0x01) ? 0x80 : 0x00;
+    if (!exists) wp[3] |= ns_r_nxdomain;
+    ns_put16(1, wp + 4);
+    ns_put16(0, wp + 6);
+    ns_put16(0, wp + 8);
+    ns_put16(edns ? 1 : 0, wp + 10);
+    wp += NS_HFIXEDSZ;
+    std::copy(query + NS_HFIXEDSZ, query + NS_HFIXEDSZ + question, wp);
+    wp += question;
+
+    bool truncated = udp && config_.truncate > 0 &&
+                     chance(random) < config_.truncate;
+
+    unsigned short ancount = 0;
+    auto put = [&](const unsigned char* rdata, const size_t rdlen) {
+        if (truncated) return;
+        if ((wp - buf) + NS_INT16SZ + NS_RRFIXEDSZ + rdlen + reserve > limit) {
+            truncated = true;
+            return;
+        }
+        // the name points to the question.
+        ns_put16(0xc000 | NS_HFIXEDSZ, wp);
+        wp += NS_INT16SZ;
+        ns_put16(qtype, wp);
+        ns_put16(ns_c_in, wp + 2);
+        ns_put32(RESPONDER_TTL, wp + 4);
+        ns_put16(rdlen, wp + 8);
+        wp += NS_RRFIXEDSZ;
+        std::copy(rdata, rdata + rdlen, wp);
+        wp += rdlen;
+        ancount++;
+    };
+
+    if (records != nullptr) {
+        for (const std::string& rdata : *records) {
+            put((const unsigned char*)rdata.data(), rdata.size());
+        }
+    } else if (!config_.zone || config_.zone->empty()) {
+        if (qtype == ns_t_a) put(v4, sizeof(v4));
+        if (qtype == ns_t_aaaa) put(v6, sizeof(v6));
+    }
+
+    // a truncated answer keeps only the question.
+    if (truncated) {
+        wp = buf + NS_HFIXEDSZ + question;
+        ancount = 0;
+        buf[2] |= 0x02;
+    }
+    ns_put16(ancount, buf + 6);
+
+    if (edns) {
+        *wp++ = 0;
+        ns_put16(ns_t_opt, wp);
+        ns_put16(EDNS0_BUFFER_SIZE, wp + 2);
+        ns_put32(0, wp + 4);
+        ns_put16(0, wp + 8);
+        wp += NS_RRFIXEDSZ;
+    }
+
+    return wp - buf;
+}
+}  // namespace dns
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <cstdint>
+
+#include "./dns_tls.hpp"
+
+// packets per recvmmsg()/sendmmsg() of the responder.
+#define RESPONDER_BATCH 64
+// TTL of the answers in seconds.
+#define RESPONDER_TTL 300
+
+namespace dns {
+
+// Zone keeps the records to answer with, keyed by the query name in wire
+// format (lower case) and the type, so a query is looked up straight from
+// the packet.
+class Zone {
+public:
+    Zone();
+
+    // load() reads "name type data" per line. A, AAAA, CNAME, NS, PTR, MX
+    // ("preference name") and TXT are supported.
+    int load(const std::string& filename);
+
+    // find() returns the rdata of the records for key, the wire name
+    // followed by the type, or nullptr. exists is set when the name has
+    // records of any type.
+    const std::vector<std::string>* find(const std::string_view key,
+                                         bool& exists) const;
+
+    bool empty() const { return records_.empty(); }
+
+private:
+    // lets find() look up a string_view without making a string.
+    struct Hash {
+        using is_transparent = void;
+        size_t operator()(const std::string_view key) const {
+            return std::hash<std::string_view>{}(key);
+        }
+    };
+
+    std::unordered_map<std::string, std::vector<std::string>, Hash,
+                       std::equal_to<>>
+        records_;
+    std::unordered_set<std::string, Hash, std::equal_to<>> names_;
+};
+
+struct ResponderConfig {
+    std::string address;
+    unsigned int port;
+    unsigned int threads;
+
+    // without a zone every A/AAAA query gets a loopback address.
+    std::shared_ptr<Zone> zone;
+
+    // artificial latency added to every answer.
+    std::chrono::nanoseconds delay;
+    // probability that a query is ignored, or that a UDP answer is cut to
+    // the header and the question with the TC bit.
+    double drop;
+    double truncate;
+
+    // DNS over TLS is served on tlsPort unless it's 0, with the certificate
+    // and the key from PEM files, or a self-signed one for localhost.
+    unsigned int tlsPort;
+    std::string cert;
+    std::string key;
+};
+
+// Responder answers queries over UDP, TCP and TLS on every thread. The threads
+// bind their own sockets with SO_REUSEPORT, so the kernel spreads queries
+// between them and they share nothing.
+class Responder {
+public:
+    Responder(const ResponderConfig& config);
+
+    // run() serves until stop() is called, and returns 1 if a thread failed
+    // to bind its sockets.
+    int run();
+    void stop() { running_ = false; }
+
+private:
+    struct Connection {
+        std::vector<unsigned char> rbuf;
+        std::vector<unsigned char> wbuf;
+        bool writing;
+        // TLS connections read and write through ssl once handshaking is
+        // done.
+        SSL* ssl;
+        bool handshaking;
+        // tells this connection from an earlier one on the same fd.
+        uint64_t generation;
+    };
+
+    // an answer held back by the artificial latency.
+    struct Delayed {
+        std::chrono::steady_clock::time_point due;
+        // TCP connection and its generation, or -1 for UDP.
+        int fd;
+        uint64_t generation;
+        struct sockaddr_storage addr;
+        socklen_t addrlen;
+        std::vector<unsigned char> data;
+    };
+
+    struct Worker {
+        int epfd;
+        int udp;
+        int listener;
+        int tlsListener;
+        std::unordered_map<int, Connection> connections;
+        uint64_t generation;
+        std::deque<Delayed> delayed;
+        std::string key;
+
+        // buffers of recvmmsg() and sendmmsg().
+        std::vector<unsigned char> rxbuf;
+        std::vector<unsigned char> txbuf;
+        std::vector<struct mmsghdr> msgs;
+        std::vector<struct mmsghdr> replies;
+        std::vector<struct iovec> iovs;
+        std::vector<struct iovec> riovs;
+        std::vector<struct sockaddr_storage> addrs;
+    };
+
+    const ResponderConfig config_;
+
+    std::atomic<bool> running_;
+    std::atomic<bool> failed_;
+    std::unique_ptr<TlsServer> tls_;
+
+    int open(Worker& worker);
+    void serve();
+    void receive(Worker& worker, std::mt19937_64& random);
+    void accept(Worker& worker, const int listener);
+    void stream(Worker& worker, const int fd, const uint32_t events,
+                std::mt19937_64& random);
+    int flush(Worker& worker, const int fd, Connection& connection);
+    void disconnect(Worker& worker, const int fd);
+    void release(Worker& worker);
+
+    // answer() writes the answer to query into buf and returns its length,
+    // or 0 when the query is dropped.
+    size_t answer(Worker& worker, const unsigned char* query, const size_t qlen,
+                  unsigned char* buf, const size_t buflen, const bool udp,
+                  std::mt19937_64& random);
+};
+}  // namespace dns
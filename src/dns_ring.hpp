@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace dns {
+
+// Ring is a bounded single-producer single-consumer queue. Neither side
+// blocks or takes a lock; push() fails when the ring is full and pop() when
+// it's empty.
+template <typename T, size_t N>
+class Ring {
+public:
+    Ring() : head_(0), tail_(0) {}
+
+    // remove copy constructor
+    Ring(Ring const&) = delete;
+    void operator=(Ring const&) = delete;
+
+    // push() is called by the producer only.
+    bool push(const T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == N) return false;
+
+        items_[tail % N] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // pop() is called by the consumer only.
+    bool pop(T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+
+        item = items_[head % N];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // slot() returns where the next item is written in place, or nullptr
+    // when the ring is full, and commit() hands it over. For items too large
+    // to be copied twice. Called by the producer only.
+    T* slot() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == N) return nullptr;
+        return &items_[tail % N];
+    }
+    void commit() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    }
+
+    // front() returns the next item in place, or nullptr when the ring is
+    // empty, and consume() gives its slot back. Called by the consumer only.
+    const T* front() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return nullptr;
+        return &items_[head % N];
+    }
+    void consume() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    }
+
+private:
+    // the indexes keep counting up, and are on their own cache lines so that
+    // both sides don't write to the same one.
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+
+    std::array<T, N> items_;
+};
+}  // namespace dns
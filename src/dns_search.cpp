@@ -0,0 +1,83 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "./dns_search.hpp"
+
+namespace dns {
+
+SearchTester::SearchTester(const TestConfig& config,
+                           const SearchConfig& search)
+    : config_(config), search_(search), sustainable_(0) {}
+
+void SearchTester::run() {
+    // the highest rate which met the SLO, and the lowest which breached it.
+    double passed = 0;
+    double breached = 0;
+
+    double rate = search_.start;
+    for (unsigned int i = 0; i < SEARCH_MAX_STEPS; i++) {
+        if (test(rate) == PASSED) {
+            passed = rate;
+        } else {
+            breached = rate;
+        }
+
+        if (breached == 0) {
+            rate = search_.step > 0 ? rate + search_.step : rate * 2;
+            continue;
+        }
+        if (breached - passed <= std::max(breached * SEARCH_PRECISION, 1.0)) {
+            break;
+        }
+        rate = (passed + breached) / 2;
+    }
+
+    sustainable_ = passed;
+}
+
+SearchTester::Verdict SearchTester::test(const double rate) {
+    TestConfig config = config_;
+    config.qps = rate;
+    config.samples = std::max<unsigned int>(
+        rate * std::chrono::duration<double>(search_.duration).count(), 1);
+
+    Tester tester(config);
+    tester.run();
+    std::unique_ptr<TestStats> stats = tester.report();
+
+    Verdict verdict = PASSED;
+    if (!stats || stats->latency.count() == 0) {
+        verdict = SILENT;
+    } else if (stats->sendRate < rate * SEARCH_RATE_SLACK) {
+        verdict = RATE;
+    } else if (stats->failure > stats->samples * search_.maxFailure) {
+        verdict = FAILURE;
+    } else if (stats->percentile(search_.percentile) > search_.slo) {
+        verdict = LATENCY;
+    }
+
+    if (config_.verbose) {
+        std::cerr << std::fixed << std::setprecision(1) << rate << " qps: ";
+        if (stats && stats->latency.count() > 0) {
+            std::cerr << std::setprecision(3)
+                      << stats->percentile(search_.percentile) << " ms, "
+                      << stats->failure << " failed";
+        } else {
+            std::cerr << "no answer, " << (stats ? stats->failure : 0)
+                      << " failed";
+        }
+        std::cerr << (verdict == PASSED ? "" : ", breached") << std::endl;
+    }
+
+    steps_.push_back(Step{rate, verdict, std::move(stats)});
+    return verdict;
+}
+
+std::vector<SearchTester::Step> SearchTester::report() {
+    std::vector<Step> steps = std::move(steps_);
+    std::stable_sort(steps.begin(), steps.end(),
+                     [](const Step& a, const Step& b) { return a.rate < b.rate; });
+    return steps;
+}
+}  // namespace dns
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <chrono>
+
+#include "./dns_tester.hpp"
+
+// steps run at most by a search, ramping and bisecting together.
+#define SEARCH_MAX_STEPS 32
+// the search stops when the highest rate which met the SLO is within this
+// ratio of the lowest which breached it.
+#define SEARCH_PRECISION 0.05
+// a step must send at least this ratio of its target rate, or the client
+// couldn't offer the load.
+#define SEARCH_RATE_SLACK 0.95
+
+namespace dns {
+
+struct SearchConfig {
+    // answer time in milliseconds the percentile must stay under, and the
+    // ratio of failed queries allowed.
+    double slo;
+    double percentile;
+    double maxFailure;
+
+    // the first rate, and the rate added every step until the SLO is
+    // breached. a step of 0 doubles the rate instead.
+    double start;
+    double step;
+
+    // how long every step sends queries.
+    std::chrono::milliseconds duration;
+};
+
+// SearchTester finds the capacity of a name server: it runs open-loop tests
+// at rising rates until the SLO is breached, then bisects between the
+// highest rate which met the SLO and the lowest which didn't.
+class SearchTester {
+public:
+    enum Verdict {
+        PASSED,
+        // the answer time percentile was over the SLO.
+        LATENCY,
+        // too many queries failed.
+        FAILURE,
+        // the client fell behind the schedule.
+        RATE,
+        // no answer was received.
+        SILENT,
+    };
+
+    struct Step {
+        double rate;
+        Verdict verdict;
+        // nullptr when no answer was received.
+        std::unique_ptr<TestStats> stats;
+    };
+
+    SearchTester(const TestConfig& config, const SearchConfig& search);
+
+    void run();
+
+    // report() returns the steps ordered by rate, which is the load/latency
+    // curve of the server.
+    std::vector<Step> report();
+
+    // sustainable() is the highest rate which met the SLO, or 0.
+    double sustainable() const { return sustainable_; }
+
+private:
+    const TestConfig config_;
+    const SearchConfig search_;
+
+    std::vector<Step> steps_;
+    double sustainable_;
+
+    Verdict test(const double rate);
+};
+}  // namespace dns
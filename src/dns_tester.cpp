@@ -1,107 +1,596 @@
+#include <arpa/nameser.h>
+
 #include <algorithm>
-#include <numeric>
+#include <random>
+#include <map>
+#include <climits>
+#include <cmath>
 
 #include "./dns_tester.hpp"
+#include "./dns_engine.hpp"
+#include "./dns_query.hpp"
+#include "./dns_decoder.hpp"
+#include "./dns_affinity.hpp"
 #include "./utils.hpp"
 
 namespace dns {
 
-Tester::Tester(const std::string target, const Type query,
-               const unsigned int samples, const unsigned int concurrency,
-               const bool verbose)
-    : target_(target),
-      query_(query),
-      samples_(samples),
-      concurrency_(concurrency),
-      verbose_(verbose),
-      running_(false) {
-    for (int i = 0; i < concurrency; i++) {
-        std::thread worker([this] {
+Tester::Tester(const TestConfig& config)
+    : config_(config),
+      ready_(0),
+      running_(false),
+      counter_(0),
+      results_(config.concurrency),
+      rings_(config.intervals ? config.concurrency : 0),
+      stopped_(false) {
+    std::random_device rd;
+    base_ = (uint64_t)rd() << 32 | rd();
+
+    if (config_.verify > 0) {
+        verifier_ = std::make_unique<Verifier>(config_.expected,
+                                               config_.concurrency);
+    }
+
+    if (!config_.ns.empty()) {
+        ns_ = config_.ns;
+    } else {
+        ConfigLoader& confLoader = ConfigLoader::getInstance();
+        ns_ = confLoader.load().front();
+    }
+
+    for (unsigned int i = 0; i < config_.concurrency; i++) {
+        std::thread worker([this, i] {
 #ifndef NDEBUG
             util::debug(std::this_thread::get_id(), " - Launched");
 #endif
-            {
-                std::unique_lock lock(mtx_);
-                cond_.wait(lock, [this] { return running_ == true; });
+            // the engine is opened after pinning, so that its sockets and
+            // buffers are on the node of the CPU.
+            if (!config_.cpus.empty()) {
+                unsigned int worker = config_.process * config_.concurrency + i;
+                pin(config_.cpus[worker % config_.cpus.size()]);
             }
-#ifndef NDEBUG
-            util::debug(std::this_thread::get_id(), " - Started to work");
-#endif
 
-            while (counter_ < samples_) {
-                ++counter_;
-                doTest();
+            doTest(i);
 #ifndef NDEBUG
-                util::debug(std::this_thread::get_id(), " - Done");
+            util::debug(std::this_thread::get_id(), " - Done");
 #endif
-            }
         });
         pool_.emplace_back(std::move(worker));
     }
 }
 
+void Tester::ready() {
+    std::unique_lock lock(mtx_);
+    cond_.wait(lock, [this] { return ready_ == pool_.size(); });
+}
+
 void Tester::run() {
-    running_ = true;
+    ready();
+    run(std::chrono::steady_clock::now());
+}
+
+void Tester::run(const std::chrono::steady_clock::time_point start) {
+    ready();
+    {
+        std::lock_guard lock(mtx_);
+        running_ = true;
+        start_ = start;
+    }
+
+    std::thread reporter;
+    if (config_.intervals) {
+        reporter = std::thread([this] { doReport(); });
+    }
+    if (verifier_) verifier_->start();
 
     cond_.notify_all();
     for (std::thread& worker : pool_) {
         worker.join();
     }
+
+    end_ = std::chrono::steady_clock::now();
+
+    if (verifier_) verifier_->stop();
+
+    if (reporter.joinable()) {
+        stopped_ = true;
+        reporter.join();
+    }
 }
 
 std::unique_ptr<TestStats> Tester::report() {
-    if (results_.empty()) return nullptr;
+    std::unique_ptr<TestStats> stats =
+        aggregate(results_, start_, end_, config_.qps);
+    if (stats && verifier_) stats->verify.merge(verifier_->stats());
+    return stats;
+}
 
-    int count = 0;
-    int success = 0, failure = 0;
+std::unique_ptr<TestStats> Tester::aggregate(
+    const std::vector<WorkerStats>& results,
+    const std::chrono::steady_clock::time_point start,
+    const std::chrono::steady_clock::time_point end, const double qps) {
+    std::unique_ptr<TestStats> stats = std::make_unique<TestStats>();
 
-    std::vector<Answer::Metrics> dataset;
-    for (std::shared_ptr<Answer> answer : results_) {
-        count++;
-        if (answer->status == Answer::Ok) {
-            success++;
-        } else {
-            failure++;
+    std::chrono::steady_clock::time_point sent = start;
+
+    stats->success = 0;
+    stats->failure = 0;
+    stats->syscalls = 0;
+    stats->connects = 0;
+    stats->timeouts = 0;
+    stats->retries = 0;
+    stats->late = 0;
+    stats->duplicates = 0;
+    stats->stray = 0;
+    for (const WorkerStats& result : results) {
+        stats->success += result.success;
+        stats->failure += result.failure;
+        stats->syscalls += result.syscalls;
+        stats->connects += result.connects;
+        stats->timeouts += result.timeouts;
+        stats->retries += result.retries;
+        stats->late += result.late;
+        stats->duplicates += result.duplicates;
+        stats->stray += result.stray;
+        stats->outcomes.merge(result.outcomes);
+        stats->verify.merge(result.verify);
+        stats->setup.merge(result.setup);
+        stats->handshake.merge(result.handshake);
+        stats->resumption.merge(result.resumption);
+        stats->latency.merge(result.latency);
+        stats->wire.merge(result.wire);
+        stats->lag.merge(result.lag);
+        for (int i = 0; i < TYPE_NUM; i++) {
+            stats->types[i].merge(result.types[i]);
         }
-        dataset.push_back(answer->metrics);
+        stats->fixed.merge(result.fixed);
+        stats->unique.merge(result.unique);
+        sent = std::max(sent, result.sent);
     }
+    stats->samples = stats->success + stats->failure;
 
-    sort(dataset.begin(), dataset.end(),
-         [](Answer::Metrics a, Answer::Metrics b) {
-             return a.elapsed < b.elapsed;
-         });
+    // a run without answers still reports its timeouts and failures.
+    if (stats->samples == 0) return nullptr;
 
-    std::unique_ptr<TestStats> stats = std::make_unique<TestStats>();
+    stats->avgTime = stats->latency.mean() / 1e6;
+    stats->maxTime = stats->latency.max() / 1e6;
+    stats->minTime = stats->latency.min() / 1e6;
+
+    std::chrono::duration<double> duration = end - start;
+    std::chrono::duration<double> sending = sent - start;
 
-    stats->samples = count;
+    stats->duration = duration.count();
+    stats->answerRate = stats->success / stats->duration;
+    stats->targetRate = qps;
+    stats->sendRate =
+        sending.count() > 0 ? stats->samples / sending.count() : 0.0;
 
-    stats->success = success;
-    stats->failure = failure;
+    return stats;
+}
 
-    stats->avgTime =
-        std::accumulate(dataset.begin(), dataset.end(), 0.0,
-                        [&](double acc, Answer::Metrics metrics) {
-                            return acc + (metrics.elapsed.count() / count);
-                        });
-    stats->maxTime = dataset.back().elapsed.count();
-    stats->minTime = dataset.front().elapsed.count();
-    stats->prctileTime70 = dataset[(dataset.size() - 1) * 0.70].elapsed.count();
-    stats->prctileTime80 = dataset[(dataset.size() - 1) * 0.80].elapsed.count();
-    stats->prctileTime90 = dataset[(dataset.size() - 1) * 0.90].elapsed.count();
-    stats->prctileTime95 = dataset[(dataset.size() - 1) * 0.95].elapsed.count();
+void TestStats::merge(const TestStats& other) {
+    samples += other.samples;
+    success += other.success;
+    failure += other.failure;
+    syscalls += other.syscalls;
+    connects += other.connects;
+    timeouts += other.timeouts;
+    retries += other.retries;
+    late += other.late;
+    duplicates += other.duplicates;
+    stray += other.stray;
+    outcomes.merge(other.outcomes);
+    verify.merge(other.verify);
 
-    return std::move(stats);
+    latency.merge(other.latency);
+    setup.merge(other.setup);
+    handshake.merge(other.handshake);
+    resumption.merge(other.resumption);
+    wire.merge(other.wire);
+    lag.merge(other.lag);
+    for (int i = 0; i < TYPE_NUM; i++) {
+        types[i].merge(other.types[i]);
+    }
+    fixed.merge(other.fixed);
+    unique.merge(other.unique);
+
+    avgTime = latency.mean() / 1e6;
+    maxTime = latency.max() / 1e6;
+    minTime = latency.min() / 1e6;
+
+    duration = std::max(duration, other.duration);
+    answerRate = success / duration;
+    targetRate += other.targetRate;
+    sendRate += other.sendRate;
 }
 
-void Tester::doTest() {
-    std::unique_ptr<Client> client = std::make_unique<Client>();
+// doTest() keeps up to config_.inflight queries outstanding on one engine
+// until all samples have been claimed and answered. In open-loop mode the
+// queries are sent on a fixed schedule instead, whatever is outstanding.
+void Tester::doTest(const unsigned int index) {
+    WorkerStats& result = results_[index];
+    // live counters of the worker, which the exporter reads while it runs.
+    WorkerMetrics* live =
+        config_.metrics ? &config_.metrics->worker(
+                              config_.server,
+                              config_.process * config_.concurrency + index)
+                        : nullptr;
 
-    client->resolv(target_, query_, false, 1);
-    std::shared_ptr<Answer> result = client->answer();
+    Engine engine(ns_, config_.port, config_.sockets, config_.batch,
+                  config_.transport);
+    engine.setTimeout(config_.timeout, config_.retries);
+    engine.setBackend(config_.backend);
+    engine.setTimestamps(config_.timestamps);
+    engine.setTls(config_.tlsName, config_.tlsCa);
+    if (config_.sourcePort > 0) {
+        // every worker of every process and server has its own ports.
+        unsigned int worker =
+            (config_.server * config_.processes + config_.process) *
+                config_.concurrency +
+            index;
+        engine.setSourcePort(config_.sourcePort + worker * config_.sockets);
+    }
+    // connections are established and queries encoded before the clock
+    // starts, so that neither is part of the duration or the schedule.
+    QueryArena arena;
+    std::vector<unsigned int> order;
+    bool failed = engine.open() || prepare(index, arena, order);
 
     {
-        std::lock_guard lock(mtx_);
-        results_.push_back(result);
+        std::unique_lock lock(mtx_);
+        ready_++;
+        cond_.notify_all();
+        cond_.wait(lock, [this] { return running_ == true; });
+    }
+#ifndef NDEBUG
+    util::debug(std::this_thread::get_id(), " - Started to work");
+#endif
+
+    // a worker which failed to set up fails the queries it claims.
+    if (failed) {
+        while (counter_++ < config_.samples) result.failure++;
+        if (live) WorkerMetrics::bump(live->failure, result.failure);
+        return;
     }
+    size_t cursor = 0;
+
+    // with labels, every query is a copy with its own label, of the query
+    // for the name as given on a hit, or of its labeled twin right after it
+    // on a miss. tags are the handles of the copies then.
+    bool labeled = config_.labels != FIXED;
+    QueryPool pool(arena);
+    std::mt19937_64 random(std::random_device{}());
+    uint64_t hits = config_.hitRatio >= 1.0
+                        ? UINT64_MAX
+                        : (uint64_t)std::ldexp(config_.hitRatio, 64);
+    auto pick = [&](const uint64_t n, unsigned char*& query, size_t& qlen) {
+        unsigned int q = order[cursor++ % order.size()];
+        if (!labeled) {
+            query = arena.data(q);
+            qlen = arena.at(q).length;
+            return q;
+        }
+        if (hits == 0 || random() >= hits) q++;
+        unsigned int handle =
+            pool.take(q, config_.labels == SEQUENTIAL ? base_ + n : random());
+        query = pool.data(handle);
+        qlen = pool.length(handle);
+        return handle;
+    };
+    // release() gives the copy back, and returns the query it was made of.
+    auto release = [&](const unsigned int tag) -> const QueryArena::Query& {
+        if (!labeled) return arena.at(tag);
+        size_t q = pool.query(tag);
+        pool.release(tag);
+        return arena.at(q);
+    };
+    auto fail = [&](const unsigned int tag) {
+        const QueryArena::Query& query = release(tag);
+        result.failure++;
+        result.types[query.type].failure++;
+        (query.label > 0 ? result.unique : result.fixed).failure++;
+        if (live) WorkerMetrics::bump(live->failure);
+    };
+
+    // every worker sends at qps / concurrency, and workers (of all
+    // processes and servers) are shifted from each other so that the
+    // schedule is interleaved.
+    bool openloop = config_.qps > 0;
+    std::chrono::steady_clock::duration interval{0};
+    std::chrono::steady_clock::time_point next = start_;
+    if (openloop) {
+        unsigned int workers =
+            config_.concurrency * config_.processes * config_.servers;
+        unsigned int worker =
+            (config_.process * config_.concurrency + index) * config_.servers +
+            config_.server;
+        interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(config_.concurrency / config_.qps));
+        next += interval * worker / workers;
+    }
+
+    std::vector<Engine::Response> responses;
+    responses.reserve(ENGINE_RECV_BURST);
+
+    std::chrono::steady_clock::time_point sent = start_;
+    // answers since the last one sampled for the verifier.
+    unsigned int unsampled = 0;
+
+    bool claimed = true;
+    while (true) {
+        std::chrono::nanoseconds timeout{-1};
+        if (openloop) {
+            std::chrono::steady_clock::time_point now =
+                std::chrono::steady_clock::now();
+            // latency is measured from the scheduled time, so a sender lagging
+            // behind still charges the delay to the queries.
+            while (claimed && next <= now) {
+                uint64_t n = counter_++;
+                if (!(claimed = n < config_.samples)) break;
+                unsigned char* query;
+                size_t qlen;
+                unsigned int tag = pick(n, query, qlen);
+                if (engine.send(query, qlen, next, tag)) {
+                    fail(tag);
+                } else if (live) {
+                    WorkerMetrics::bump(live->sent);
+                }
+                next += interval;
+                sent = now;
+            }
+            if (claimed) {
+                timeout = next - now;
+            }
+        } else {
+            unsigned int inflight = engine.inflight();
+            while (claimed && engine.inflight() < config_.inflight) {
+                uint64_t n = counter_++;
+                if (!(claimed = n < config_.samples)) break;
+                unsigned char* query;
+                size_t qlen;
+                unsigned int tag = pick(n, query, qlen);
+                if (engine.send(query, qlen, tag)) {
+                    fail(tag);
+                } else if (live) {
+                    WorkerMetrics::bump(live->sent);
+                }
+            }
+            if (engine.inflight() != inflight) {
+                sent = std::chrono::steady_clock::now();
+            }
+        }
+
+        if (!claimed && engine.inflight() == 0) break;
+
+        // wake up to hand over the interval even when nothing happens.
+        if (config_.intervals) {
+            std::chrono::nanoseconds until =
+                start_ + config_.interval * (result.interval.index + 1) -
+                std::chrono::steady_clock::now();
+            until = std::max(until, std::chrono::nanoseconds(0));
+            if (timeout.count() < 0 || until < timeout) timeout = until;
+        }
+
+        if (engine.poll(timeout, responses)) {
+            result.failure += engine.inflight();
+            if (live) WorkerMetrics::bump(live->failure, engine.inflight());
+            break;
+        }
+
+        for (Engine::Response& response : responses) {
+            std::chrono::nanoseconds elapsed =
+                response.received - response.scheduled;
+            // a query without answer has no answer time. an answer coming
+            // after the copy is reused counts as stray rather than late.
+            if (response.timeout || response.failed) {
+                if (live && response.timeout) {
+                    WorkerMetrics::bump(live->timeouts);
+                }
+                fail(response.tag);
+                continue;
+            }
+            const QueryArena::Query& query = release(response.tag);
+            TypeStats& typed = result.types[query.type];
+            TypeStats& named = query.label > 0 ? result.unique : result.fixed;
+            // only the header and sections are checked in the timed path.
+            Summary summary;
+            int invalid = validate(response.data, response.length, summary);
+            result.outcomes.count(summary);
+            typed.outcomes.count(summary);
+            named.outcomes.count(summary);
+            // the misses of labeled names are expected to be NXDOMAIN, which
+            // is a well-formed answer to them rather than a failure.
+            bool answered =
+                invalid == 0 ||
+                (query.label > 0 && summary.status == Summary::Error &&
+                 summary.rcode == ns_r_nxdomain);
+            if (verifier_) {
+                bool anomalous = !answered;
+                if (anomalous || ++unsampled >= config_.verify) {
+                    (anomalous ? result.verify.anomalous : result.verify.sampled)++;
+                    if (!verifier_->submit(index, response.data, response.length)) {
+                        result.verify.skipped++;
+                    }
+                    if (!anomalous) unsampled = 0;
+                }
+            }
+            if (answered) {
+                result.success++;
+                typed.success++;
+                named.success++;
+            } else {
+                result.failure++;
+                typed.failure++;
+                named.failure++;
+            }
+            result.latency.record(elapsed.count());
+            typed.latency.record(elapsed.count());
+            named.latency.record(elapsed.count());
+            if (live) {
+                WorkerMetrics::bump(answered ? live->success : live->failure);
+                live->record(elapsed.count());
+            }
+            if (config_.timestamps) {
+                if (response.stamped && response.received >= response.sent) {
+                    result.wire.record(
+                        (response.received - response.sent).count());
+                }
+                result.lag.record(response.lag.count());
+            }
+            if (config_.intervals) {
+                result.interval.latency.record(elapsed.count());
+            }
+        }
+
+        if (config_.intervals) publish(index, engine.timeouts(), false);
+    }
+
+    if (config_.intervals) publish(index, engine.timeouts(), true);
+    result.syscalls = engine.syscalls();
+    result.connects = engine.connects();
+    result.timeouts = engine.timeouts();
+    result.retries = engine.retries();
+    result.late = engine.late();
+    result.duplicates = engine.duplicates();
+    result.stray = engine.stray();
+    result.setup = engine.setup();
+    result.handshake = engine.fullHandshakes();
+    result.resumption = engine.resumedHandshakes();
+    result.sent = sent;
+}
+// publish() hands the stats gathered since the last interval ended to the
+// reporter, unless the ring is full. Then they're kept gathering until the
+// next try. The last one is always handed over.
+void Tester::publish(const unsigned int index, const uint64_t timeouts,
+                     const bool last) {
+    WorkerStats& result = results_[index];
+    IntervalStats& interval = result.interval;
+
+    unsigned int current =
+        (std::chrono::steady_clock::now() - start_) / config_.interval;
+    if (!last && current <= interval.index) return;
+
+    // stats of several intervals are put together in the last one when the
+    // worker missed their ends.
+    interval.index = last ? current : current - 1;
+    interval.last = last;
+    interval.success = result.success - result.intervalSuccess;
+    interval.failure = result.failure - result.intervalFailure;
+    interval.timeouts = timeouts - result.intervalTimeouts;
+
+    if (last) {
+        while (!rings_[index].push(interval)) std::this_thread::yield();
+    } else if (!rings_[index].push(interval)) {
+        return;
+    }
+
+    interval.index = current;
+    interval.latency.reset();
+    result.intervalSuccess = result.success;
+    result.intervalFailure = result.failure;
+    result.intervalTimeouts = timeouts;
+}
+
+// doReport() merges the snapshots of the workers and writes an interval
+// once every worker handed over its stats up to the end of it.
+void Tester::doReport() {
+    std::vector<unsigned int> covered(config_.concurrency, 0);
+    std::map<unsigned int, IntervalStats> pending;
+    unsigned int next = 0;
+
+    std::chrono::nanoseconds nap =
+        std::max<std::chrono::nanoseconds>(config_.interval / 10,
+                                           std::chrono::milliseconds(1));
+    double length = std::chrono::duration<double>(config_.interval).count();
+
+    bool stopping;
+    do {
+        // workers are done when stopped_ is seen, so nothing is left behind
+        // after the rings are drained.
+        stopping = stopped_;
+
+        IntervalStats snapshot;
+        for (unsigned int i = 0; i < rings_.size(); i++) {
+            while (rings_[i].pop(snapshot)) {
+                IntervalStats& merged = pending[snapshot.index];
+                merged.index = snapshot.index;
+                merged.merge(snapshot);
+                covered[i] = snapshot.last ? UINT_MAX : snapshot.index + 1;
+            }
+        }
+
+        // intervals before ready are complete. all of them are at the end.
+        unsigned int ready = *std::min_element(covered.begin(), covered.end());
+        if (stopping) {
+            ready = pending.empty() ? next
+                                    : std::max(next, pending.rbegin()->first + 1);
+        } else if (ready == UINT_MAX) {
+            ready = next;
+        }
+
+        for (; next < ready; next++) {
+            IntervalStats& stats = pending[next];
+            stats.index = next;
+
+            double begin = next * length;
+            double time = begin + length;
+            // the last interval ends with the test.
+            if (stopping && next + 1 == ready) {
+                time = std::min(
+                    time, std::chrono::duration<double>(end_ - start_).count());
+            }
+
+            config_.intervals->write(ns_, stats, time, time - begin);
+            pending.erase(next);
+        }
+
+        if (!stopping) std::this_thread::sleep_for(nap);
+    } while (!stopping);
+}
+
+// prepare() encodes the queries of the worker into arena, and fills order
+// with the sequence in which the worker sends them.
+int Tester::prepare(const unsigned int index, QueryArena& arena,
+                    std::vector<unsigned int>& order) {
+    // with labels, every query is followed by its twin with a label.
+    auto add = [&](const std::string_view name, const Type type) {
+        int q = arena.add(name, type, config_.recurse, config_.edns);
+        if (q >= 0 && (config_.labels == FIXED ||
+                       arena.add(name, type, config_.recurse, config_.edns,
+                                 QUERY_LABEL_WIDTH) >= 0)) {
+            order.push_back(q);
+        }
+    };
+
+    if (!config_.corpus) {
+        add(config_.target, config_.query);
+        return order.empty() ? 1 : 0;
+    }
+
+    const Corpus& corpus = *config_.corpus;
+
+    // every worker takes every n-th query where n is the number of workers
+    // of all processes, unless there are not enough queries to go around.
+    size_t step = config_.concurrency * config_.processes;
+    size_t first = config_.process * config_.concurrency + index;
+    if (corpus.size() < step) {
+        first = 0;
+        step = 1;
+    }
+
+    size_t count = (corpus.size() - first + step - 1) / step;
+    if (config_.labels != FIXED) count *= 2;
+    arena.reserve(count, count * 64);
+    for (size_t i = first; i < corpus.size(); i += step) {
+        add(corpus[i].name, corpus[i].type);
+    }
+    if (order.empty()) return 1;
+
+    if (config_.shuffle) {
+        std::random_device rd;
+        std::shuffle(order.begin(), order.end(), std::mt19937_64(rd()));
+    }
+
+    return 0;
 }
-}  // namespace dns
\ No newline at end of file
+}  // namespace dns
@@ -6,56 +6,317 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
+#include <array>
+#include <vector>
 
 #include "./dns_client.hpp"
+#include "./dns_histogram.hpp"
+#include "./dns_decoder.hpp"
+#include "./dns_query.hpp"
+#include "./dns_corpus.hpp"
+#include "./dns_interval.hpp"
+#include "./dns_ring.hpp"
+#include "./dns_verify.hpp"
+#include "./dns_metrics.hpp"
+
+// interval snapshots a worker can hand over before the reporter takes them.
+#define TESTER_INTERVAL_RING 8
 
 namespace dns {
 
+struct TestConfig {
+    std::string target;
+    Type query;
+
+    // queries replayed instead of target when given. the corpus is split
+    // between threads, and each thread cycles through its part in order or
+    // shuffled.
+    std::shared_ptr<Corpus> corpus;
+    bool shuffle;
+
+    // a unique label is prepended to the names of all but hitRatio (0 - 1)
+    // of the queries, so they're resolved instead of answered from cache.
+    LabelMode labels;
+    double hitRatio;
+
+    // name server address. resolv.conf is used when empty.
+    std::string ns;
+    unsigned int port;
+
+    bool recurse;
+    bool edns;
+
+    unsigned int samples;
+    unsigned int concurrency;
+
+    // index of this process among processes running the same test. workers
+    // of all processes share the schedule and the corpus between them.
+    unsigned int process;
+    unsigned int processes;
+
+    // index of this server among servers tested side by side. their
+    // schedules are interleaved like those of processes.
+    unsigned int server;
+    unsigned int servers;
+
+    // UDP sockets and outstanding queries per worker thread.
+    unsigned int sockets;
+    unsigned int inflight;
+    // packets per sendmmsg()/recvmmsg(). 1 uses send()/recv().
+    unsigned int batch;
+
+    // over TCP and TLS, sockets are persistent connections and inflight
+    // queries are pipelined on them.
+    Transport transport;
+    // the TLS certificate is verified for tlsName against tlsCa (or the
+    // system CAs) when tlsName is given.
+    std::string tlsName;
+    std::string tlsCa;
+    // io_uring applies to UDP only.
+    Backend backend;
+
+    // workers (of all processes) are pinned to these CPUs in turn when
+    // given, so their sockets and buffers stay on the node of the CPU.
+    std::vector<int> cpus;
+
+    // sockets are bound to consecutive source ports from this port, one
+    // range per worker, instead of ephemeral ports. 0 leaves it to the
+    // kernel.
+    unsigned int sourcePort;
+
+    // answer times are taken from kernel timestamps of UDP packets, and
+    // how long answers waited to be read is reported.
+    bool timestamps;
+
+    // a query is given up as failed when no answer came within timeout, after
+    // being resent retries times over UDP.
+    std::chrono::milliseconds timeout;
+    unsigned int retries;
+
+    // queries per second across all threads in open-loop mode. queries are
+    // sent on a fixed schedule and 0 means closed-loop.
+    double qps;
+
+    // 1 in verify answers, and every anomalous one, is decoded in full on a
+    // background thread, and the records of the queried type are checked
+    // against expected when it's given. 0 turns it off.
+    unsigned int verify;
+    std::vector<std::string> expected;
+
+    // snapshots of every interval are written when given. the final results
+    // are reported as usual.
+    std::shared_ptr<IntervalWriter> intervals;
+    std::chrono::milliseconds interval;
+
+    // live counters and answer times are served while the test runs when
+    // given. the exporter must be started before.
+    std::shared_ptr<MetricsExporter> metrics;
+
+    bool verbose;
+};
+
+// OutcomeStats counts what the answers said: every RCODE, the TC, AA and RA
+// flags, and answers which couldn't be read at all.
+struct OutcomeStats {
+    std::array<uint64_t, DNS_RCODE_NUM> rcodes;
+    uint64_t truncated;
+    uint64_t authoritative;
+    uint64_t recursive;
+    uint64_t malformed;
+
+    void count(const Summary& summary) {
+        if (summary.status == Summary::Malformed) {
+            malformed++;
+            return;
+        }
+        rcodes[summary.rcode]++;
+        truncated += summary.truncated;
+        authoritative += summary.authority;
+        recursive += summary.recurse;
+    }
+
+    void merge(const OutcomeStats& other) {
+        for (int i = 0; i < DNS_RCODE_NUM; i++) rcodes[i] += other.rcodes[i];
+        truncated += other.truncated;
+        authoritative += other.authoritative;
+        recursive += other.recursive;
+        malformed += other.malformed;
+    }
+};
+
+struct TypeStats {
+    uint64_t success;
+    uint64_t failure;
+
+    Histogram latency;
+    OutcomeStats outcomes;
+
+    void merge(const TypeStats& other) {
+        success += other.success;
+        failure += other.failure;
+        latency.merge(other.latency);
+        outcomes.merge(other.outcomes);
+    }
+};
+
 struct TestStats {
-    int samples;
+    uint64_t samples;
 
-    int success;
-    int failure;
+    uint64_t success;
+    uint64_t failure;
 
     double avgTime;
     double maxTime;
     double minTime;
-    double prctileTime70;
-    double prctileTime80;
-    double prctileTime90;
-    double prctileTime95;
+
+    // answer time in nanoseconds. use percentile() for the answer time of
+    // any percentile in milliseconds.
+    Histogram latency;
+
+    double duration;
+    double answerRate;
+    double targetRate;
+    double sendRate;
+
+    uint64_t syscalls;
+
+    // queries given up without an answer, and queries resent.
+    uint64_t timeouts;
+    uint64_t retries;
+    // answers not counted: arrived after the timeout, answered twice, or not
+    // matching any query.
+    uint64_t late;
+    uint64_t duplicates;
+    uint64_t stray;
+
+    // answers by RCODE and flags. failure counts every RCODE but NOERROR.
+    OutcomeStats outcomes;
+    // answers verified with verify.
+    VerifyStats verify;
+
+    // TCP connections and the time to establish them, which is not part of
+    // the answer time.
+    uint64_t connects;
+    Histogram setup;
+    // TLS handshakes after the TCP connection, full ones and resumed ones.
+    Histogram handshake;
+    Histogram resumption;
+
+    // with timestamps, the answer time between the kernel timestamps of
+    // the query and the answer, and how long answers waited in the kernel
+    // before the client read them. a growing lag means the client is
+    // overloaded.
+    Histogram wire;
+    Histogram lag;
+
+    // breakdown by query type.
+    std::array<TypeStats, TYPE_NUM> types;
+    // breakdown by queries for the names as given (cache hits) and those
+    // with a unique label (misses).
+    TypeStats fixed;
+    TypeStats unique;
+
+    double percentile(const double p) const {
+        return latency.percentile(p) / 1e6;
+    }
+
+    // merge() adds the results of a test which ran at the same time.
+    void merge(const TestStats& other);
 };
 
 class Tester {
 public:
-    Tester(const std::string target, const Type query,
-           const unsigned int samples, const unsigned int concurrency = 1,
-           const bool verbose = false);
+    Tester(const TestConfig& config);
+    // ready() waits until every worker has opened its engine and encoded
+    // its queries. run() waits for it too.
+    void ready();
     void run();
+    // run() with a start time shared by testers running at the same time.
+    void run(const std::chrono::steady_clock::time_point start);
     std::unique_ptr<TestStats> report();
 
-private:
-    const std::string target_;
-    const Type query_;
+    // results of one worker thread. only the owner writes to it while
+    // running, so no lock is needed until report() merges them.
+    struct alignas(64) WorkerStats {
+        uint64_t success;
+        uint64_t failure;
+        uint64_t syscalls;
+        uint64_t connects;
+
+        uint64_t timeouts;
+        uint64_t retries;
+        uint64_t late;
+        uint64_t duplicates;
+        uint64_t stray;
+
+        std::chrono::steady_clock::time_point sent;
+
+        OutcomeStats outcomes;
+        VerifyStats verify;
+        Histogram latency;
+        Histogram setup;
+        Histogram handshake;
+        Histogram resumption;
+        Histogram wire;
+        Histogram lag;
+        std::array<TypeStats, TYPE_NUM> types;
+        TypeStats fixed;
+        TypeStats unique;
+
+        // the interval being gathered, and the counters when it began.
+        IntervalStats interval;
+        uint64_t intervalSuccess;
+        uint64_t intervalFailure;
+        uint64_t intervalTimeouts;
+    };
 
-    const unsigned int concurrency_;
-    const unsigned int samples_;
+    // aggregate() merges the results of the workers of a run from start to
+    // end into a report, which report() adds the verifier to. It returns
+    // nullptr when no query was sent.
+    static std::unique_ptr<TestStats> aggregate(
+        const std::vector<WorkerStats>& results,
+        const std::chrono::steady_clock::time_point start,
+        const std::chrono::steady_clock::time_point end, const double qps);
 
-    const bool verbose_;
+private:
+    const TestConfig config_;
+
+    std::string ns_;
 
     std::vector<std::thread> pool_;
 
-    // mutex is supposed to be used for 2 purposes.
-    // 1. lock threads while creating a thread pool.
-    // 2. lock to record DNS answers on vector<>.
+    // mutex is used to lock threads while creating a thread pool.
     std::mutex mtx_;
     std::condition_variable cond_;
 
+    // workers which are set up, guarded by mtx_.
+    unsigned int ready_;
     std::atomic<bool> running_;
-    std::atomic<int> counter_;
+    // claimed samples, wider than samples so that the claims past the end
+    // don't wrap around.
+    std::atomic<uint64_t> counter_;
+
+    std::vector<WorkerStats> results_;
+
+    // workers hand interval snapshots to the reporter through their own ring.
+    std::vector<Ring<IntervalStats, TESTER_INTERVAL_RING>> rings_;
+    std::atomic<bool> stopped_;
+
+    std::unique_ptr<Verifier> verifier_;
+
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point end_;
 
-    std::vector<std::shared_ptr<Answer>> results_;
+    // sequential labels count from here, so another run doesn't hit the
+    // names cached by this one.
+    uint64_t base_;
 
-    void doTest();
+    void doTest(const unsigned int index);
+    void doReport();
+    void publish(const unsigned int index, const uint64_t timeouts,
+                 const bool last);
+    int prepare(const unsigned int index, QueryArena& arena,
+                std::vector<unsigned int>& order);
 };
-}  // namespace dns
\ No newline at end of file
+}  // namespace dns
@@ -0,0 +1,102 @@
+#include <algorithm>
+
+#include "./dns_timer.hpp"
+
+namespace dns {
+
+static constexpr uint64_t MASK = TIMER_SLOTS - 1;
+
+TimerWheel::TimerWheel(const std::chrono::nanoseconds resolution)
+    : resolution_(resolution), now_(0), size_(0) {}
+
+void TimerWheel::start(const std::chrono::steady_clock::time_point now) {
+    origin_ = now;
+    now_ = 0;
+}
+
+void TimerWheel::schedule(
+    const uint64_t key, const std::chrono::steady_clock::time_point deadline) {
+    // round up, so that a key never expires before its deadline.
+    std::chrono::nanoseconds delta = deadline - origin_;
+    uint64_t tick =
+        delta.count() > 0
+            ? (delta.count() + resolution_.count() - 1) / resolution_.count()
+            : 0;
+
+    place(Entry{/* key */ key, /* tick */ std::max(tick, now_)});
+    size_++;
+}
+
+void TimerWheel::advance(const std::chrono::steady_clock::time_point now,
+                         std::vector<uint64_t>& expired) {
+    std::chrono::nanoseconds delta = now - origin_;
+    if (delta.count() < 0) return;
+    uint64_t target = delta.count() / resolution_.count();
+
+    while (now_ <= target) {
+        if (size_ == 0) {
+            now_ = target + 1;
+            break;
+        }
+
+        if ((now_ & MASK) == 0 && now_ > 0) cascade(1);
+
+        std::vector<Entry>& slot = wheels_[0][now_ & MASK];
+        for (const Entry& entry : slot) {
+            expired.push_back(entry.key);
+        }
+        size_ -= slot.size();
+        slot.clear();
+
+        now_++;
+    }
+}
+
+std::chrono::steady_clock::time_point TimerWheel::next() const {
+    if (size_ == 0) return std::chrono::steady_clock::time_point::max();
+
+    // the nearest slot of the lowest wheel, or the next cascade.
+    uint64_t tick = now_;
+    uint64_t boundary = (now_ | MASK) + 1;
+    while (tick < boundary && wheels_[0][tick & MASK].empty()) tick++;
+
+    return origin_ + resolution_ * tick;
+}
+
+void TimerWheel::place(const Entry& entry) {
+    uint64_t delta = entry.tick - now_;
+
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 &&
+           delta >= (1ULL << (TIMER_SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+
+    // keys beyond the last wheel wait in its farthest slot.
+    uint64_t tick = entry.tick;
+    uint64_t limit = 1ULL << (TIMER_SLOT_BITS * TIMER_LEVELS);
+    if (delta >= limit) tick = now_ + limit - 1;
+
+    wheels_[level][(tick >> (TIMER_SLOT_BITS * level)) & MASK].push_back(entry);
+}
+
+// cascade() moves the keys of the current slot of the level down, and does
+// the same for the upper level when this one wrapped around.
+void TimerWheel::cascade(const int level) {
+    if (level >= TIMER_LEVELS) return;
+
+    uint64_t index = (now_ >> (TIMER_SLOT_BITS * level)) & MASK;
+    if (index == 0) cascade(level + 1);
+
+    std::vector<Entry> entries;
+    entries.swap(wheels_[level][index]);
+    for (const Entry& entry : entries) {
+        place(entry);
+    }
+    // give the capacity back to the slot for the next round.
+    if (wheels_[level][index].empty()) {
+        entries.clear();
+        wheels_[level][index].swap(entries);
+    }
+}
+}  // namespace dns
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#define TIMER_LEVELS 4
+#define TIMER_SLOT_BITS 8
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+
+namespace dns {
+
+// TimerWheel is a hierarchical timing wheel. Scheduling is O(1) and no
+// syscall is made, because it only moves forward when advance() is called.
+// Timers can't be cancelled; the owner checks that an expired key is still
+// wanted, e.g. with a generation number in the key.
+class TimerWheel {
+public:
+    TimerWheel(const std::chrono::nanoseconds resolution =
+                   std::chrono::milliseconds(1));
+
+    void start(const std::chrono::steady_clock::time_point now);
+
+    void schedule(const uint64_t key,
+                  const std::chrono::steady_clock::time_point deadline);
+
+    // advance() moves the wheel to now and appends the expired keys.
+    void advance(const std::chrono::steady_clock::time_point now,
+                 std::vector<uint64_t>& expired);
+
+    // next() returns the time at which advance() may expire a key next.
+    std::chrono::steady_clock::time_point next() const;
+
+    size_t size() const { return size_; }
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint64_t tick;
+    };
+
+    const std::chrono::nanoseconds resolution_;
+    std::chrono::steady_clock::time_point origin_;
+
+    // ticks before now_ are done.
+    uint64_t now_;
+    size_t size_;
+
+    std::array<std::array<std::vector<Entry>, TIMER_SLOTS>, TIMER_LEVELS>
+        wheels_;
+
+    void place(const Entry& entry);
+    void cascade(const int level);
+};
+}  // namespace dns
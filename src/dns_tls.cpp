@@ -0,0 +1,183 @@
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <iostream>
+
+#include "./dns_tls.hpp"
+
+namespace dns {
+
+// queries and answers are written from buffers which grow while a write is
+// pending, and partly written like plain TCP.
+static const long TLS_MODES =
+    SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER;
+// a peer closing without close_notify is the end of the session, as over TCP.
+static const uint64_t TLS_OPTIONS = SSL_OP_IGNORE_UNEXPECTED_EOF;
+
+TlsClient::TlsClient() : ctx_(nullptr), session_(nullptr) {}
+
+TlsClient::~TlsClient() {
+    if (session_ != nullptr) SSL_SESSION_free(session_);
+    if (ctx_ != nullptr) SSL_CTX_free(ctx_);
+}
+
+int TlsClient::open(const std::string& name, const std::string& ca) {
+    name_ = name;
+
+    if ((ctx_ = SSL_CTX_new(TLS_client_method())) == nullptr) {
+        ERR_print_errors_fp(stderr);
+        return 1;
+    }
+    SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+    SSL_CTX_set_mode(ctx_, TLS_MODES);
+    SSL_CTX_set_options(ctx_, TLS_OPTIONS);
+
+    // sessions are kept by keep() instead of the internal cache.
+    SSL_CTX_set_app_data(ctx_, this);
+    SSL_CTX_set_session_cache_mode(
+        ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx_, keep);
+
+    if (!name_.empty()) {
+        SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER, nullptr);
+        int ret = ca.empty()
+                      ? SSL_CTX_set_default_verify_paths(ctx_)
+                      : SSL_CTX_load_verify_locations(ctx_, ca.c_str(), nullptr);
+        if (ret != 1) {
+            std::cerr << "failed to load CA certificates" << std::endl;
+            ERR_print_errors_fp(stderr);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+SSL* TlsClient::connect(const int fd) {
+    SSL* ssl = SSL_new(ctx_);
+    if (ssl == nullptr || SSL_set_fd(ssl, fd) != 1) {
+        ERR_print_errors_fp(stderr);
+        SSL_free(ssl);
+        return nullptr;
+    }
+    SSL_set_connect_state(ssl);
+
+    if (!name_.empty()) {
+        SSL_set_tlsext_host_name(ssl, name_.c_str());
+        SSL_set1_host(ssl, name_.c_str());
+    }
+    // a connection which resumes a session takes it out of the cache when
+    // it gets a new ticket, and that marks the session not resumable. Every
+    // connection resumes a copy, so the others can still use it.
+    if (session_ != nullptr) {
+        SSL_SESSION* session = SSL_SESSION_dup(session_);
+        if (session != nullptr) {
+            SSL_set_session(ssl, session);
+            SSL_SESSION_free(session);
+        }
+    }
+
+    return ssl;
+}
+
+int TlsClient::keep(SSL* ssl, SSL_SESSION* session) {
+    TlsClient* client =
+        static_cast<TlsClient*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    if (client->session_ != nullptr) SSL_SESSION_free(client->session_);
+    client->session_ = session;
+
+    // the reference is taken over.
+    return 1;
+}
+
+TlsServer::TlsServer() : ctx_(nullptr) {}
+
+TlsServer::~TlsServer() {
+    if (ctx_ != nullptr) SSL_CTX_free(ctx_);
+}
+
+int TlsServer::open(const std::string& cert, const std::string& key) {
+    if ((ctx_ = SSL_CTX_new(TLS_server_method())) == nullptr) {
+        ERR_print_errors_fp(stderr);
+        return 1;
+    }
+    SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+    SSL_CTX_set_mode(ctx_, TLS_MODES);
+    SSL_CTX_set_options(ctx_, TLS_OPTIONS);
+
+    static const unsigned char context[] = "dns-benchmark-responder";
+    SSL_CTX_set_session_id_context(ctx_, context, sizeof(context) - 1);
+
+    if (cert.empty() && key.empty()) return selfSign();
+
+    if (SSL_CTX_use_certificate_chain_file(ctx_, cert.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx_, key.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx_) != 1) {
+        std::cerr << "failed to load the certificate" << std::endl;
+        ERR_print_errors_fp(stderr);
+        return 1;
+    }
+
+    return 0;
+}
+
+SSL* TlsServer::accept(const int fd) {
+    SSL* ssl = SSL_new(ctx_);
+    if (ssl == nullptr || SSL_set_fd(ssl, fd) != 1) {
+        ERR_print_errors_fp(stderr);
+        SSL_free(ssl);
+        return nullptr;
+    }
+    SSL_set_accept_state(ssl);
+
+    return ssl;
+}
+
+// selfSign() makes up a P-256 key and a certificate of it for localhost.
+int TlsServer::selfSign() {
+    EVP_PKEY* pkey = EVP_EC_gen("P-256");
+    X509* x509 = X509_new();
+    if (pkey == nullptr || x509 == nullptr) {
+        ERR_print_errors_fp(stderr);
+        EVP_PKEY_free(pkey);
+        X509_free(x509);
+        return 1;
+    }
+
+    X509_set_version(x509, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509), TLS_CERT_DAYS * 24 * 60 * 60);
+    X509_set_pubkey(x509, pkey);
+
+    X509_NAME* subject = X509_get_subject_name(x509);
+    X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC,
+                               (const unsigned char*)"localhost", -1, -1, 0);
+    X509_set_issuer_name(x509, subject);
+
+    X509V3_CTX v3;
+    X509V3_set_ctx_nodb(&v3);
+    X509V3_set_ctx(&v3, x509, x509, nullptr, nullptr, 0);
+    X509_EXTENSION* san = X509V3_EXT_conf_nid(
+        nullptr, &v3, NID_subject_alt_name, "DNS:localhost,IP:127.0.0.1");
+    if (san != nullptr) {
+        X509_add_ext(x509, san, -1);
+        X509_EXTENSION_free(san);
+    }
+
+    int status = 0;
+    if (X509_sign(x509, pkey, EVP_sha256()) == 0 ||
+        SSL_CTX_use_certificate(ctx_, x509) != 1 ||
+        SSL_CTX_use_PrivateKey(ctx_, pkey) != 1) {
+        ERR_print_errors_fp(stderr);
+        status = 1;
+    }
+
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+
+    return status;
+}
+}  // namespace dns
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <openssl/ssl.h>
+
+#include <string>
+
+// DNS over TLS (RFC 7858).
+#define DNS_TLS_PORT 853
+// lifetime of the certificate made up by TlsServer.
+#define TLS_CERT_DAYS 30
+
+namespace dns {
+
+// TlsClient makes TLS connections on connected sockets. It keeps the last
+// session the server gave it, and resumes it on the next connection, so only
+// the first handshake has to be a full one.
+class TlsClient {
+public:
+    TlsClient();
+    ~TlsClient();
+
+    // remove copy constructor
+    TlsClient(TlsClient const&) = delete;
+    void operator=(TlsClient const&) = delete;
+
+    // open() creates the context. When name is given, it's sent as SNI and
+    // the certificate is verified for it against ca (a PEM file), or the
+    // system CAs when ca is empty. Otherwise any certificate is accepted.
+    int open(const std::string& name, const std::string& ca);
+
+    // connect() returns a non-blocking client connection on fd, which
+    // resumes the last session if there is one, or nullptr.
+    SSL* connect(const int fd);
+
+    bool resumable() const { return session_ != nullptr; }
+
+private:
+    SSL_CTX* ctx_;
+    SSL_SESSION* session_;
+    std::string name_;
+
+    // keep() takes every new session given by the server.
+    static int keep(SSL* ssl, SSL_SESSION* session);
+};
+
+// TlsServer accepts TLS connections with a certificate from files, or with
+// a self-signed one for localhost made up on open(). Tickets are issued, so
+// that clients can resume their sessions.
+class TlsServer {
+public:
+    TlsServer();
+    ~TlsServer();
+
+    // remove copy constructor
+    TlsServer(TlsServer const&) = delete;
+    void operator=(TlsServer const&) = delete;
+
+    // open() loads the certificate chain and the key (PEM files), or makes
+    // up both when they're empty.
+    int open(const std::string& cert, const std::string& key);
+
+    // accept() returns a non-blocking server connection on fd, or nullptr.
+    SSL* accept(const int fd);
+
+private:
+    SSL_CTX* ctx_;
+
+    int selfSign();
+};
+}  // namespace dns
@@ -0,0 +1,198 @@
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include "./dns_uring.hpp"
+
+namespace dns {
+
+template <typename T>
+static T load(const T* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+static void store(T* p, const T value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+Uring::Uring()
+    : fd_(-1),
+      flags_(0),
+      ring_(MAP_FAILED),
+      ringlen_(0),
+      sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)),
+      sqeslen_(0),
+      tail_(0),
+      submitted_(0),
+      bufring_(static_cast<struct io_uring_buf_ring*>(MAP_FAILED)),
+      bufringlen_(0),
+      buffers_(static_cast<unsigned char*>(MAP_FAILED)),
+      size_(0),
+      count_(0),
+      buftail_(0) {}
+
+Uring::~Uring() {
+    if (buffers_ != MAP_FAILED) munmap(buffers_, count_ * size_);
+    if (bufring_ != MAP_FAILED) munmap(bufring_, bufringlen_);
+    if (sqes_ != MAP_FAILED) munmap(sqes_, sqeslen_);
+    if (ring_ != MAP_FAILED) munmap(ring_, ringlen_);
+    if (fd_ >= 0) close(fd_);
+}
+
+int Uring::open(const unsigned int entries) {
+    // completions are only run when we ask for them, by the same thread.
+    // older kernels don't know these flags, so they're tried without.
+    struct io_uring_params params;
+    for (unsigned int flags :
+         {IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER |
+              IORING_SETUP_DEFER_TASKRUN,
+          IORING_SETUP_CQSIZE}) {
+        std::memset(&params, 0, sizeof(params));
+        params.flags = flags;
+        params.cq_entries = entries * 4;
+        fd_ = syscall(__NR_io_uring_setup, entries, &params);
+        if (fd_ >= 0 || errno != EINVAL) break;
+    }
+    if (fd_ < 0) return 1;
+    flags_ = params.flags;
+
+    // one mmap for both rings, and the timeout of io_uring_enter().
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(params.features & IORING_FEAT_EXT_ARG)) {
+        return 1;
+    }
+
+    ringlen_ = std::max(
+        params.sq_off.array + params.sq_entries * sizeof(unsigned int),
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+    ring_ = mmap(nullptr, ringlen_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    sqeslen_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe*>(
+        mmap(nullptr, sqeslen_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+    if (ring_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+        perror("error on mmap()");
+        return 1;
+    }
+
+    unsigned char* ring = static_cast<unsigned char*>(ring_);
+    sqhead_ = reinterpret_cast<unsigned int*>(ring + params.sq_off.head);
+    sqtail_ = reinterpret_cast<unsigned int*>(ring + params.sq_off.tail);
+    sqmask_ = *reinterpret_cast<unsigned int*>(ring + params.sq_off.ring_mask);
+    sqentries_ = params.sq_entries;
+    cqhead_ = reinterpret_cast<unsigned int*>(ring + params.cq_off.head);
+    cqtail_ = reinterpret_cast<unsigned int*>(ring + params.cq_off.tail);
+    cqmask_ = *reinterpret_cast<unsigned int*>(ring + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(ring + params.cq_off.cqes);
+
+    // the index array maps every slot to the entry of the same index.
+    unsigned int* array =
+        reinterpret_cast<unsigned int*>(ring + params.sq_off.array);
+    for (unsigned int i = 0; i < sqentries_; i++) array[i] = i;
+
+    tail_ = submitted_ = *sqtail_;
+
+    return 0;
+}
+
+struct io_uring_sqe* Uring::sqe() {
+    if (tail_ - load(sqhead_) >= sqentries_) return nullptr;
+
+    struct io_uring_sqe* sqe = &sqes_[tail_ & sqmask_];
+    std::memset(sqe, 0, sizeof(*sqe));
+    tail_++;
+    return sqe;
+}
+
+int Uring::submit(const unsigned int wait,
+                  const std::chrono::nanoseconds timeout) {
+    store(sqtail_, tail_);
+
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout.count() / 1000000000;
+    ts.tv_nsec = timeout.count() % 1000000000;
+
+    struct io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    arg.ts = timeout.count() < 0 || wait == 0 ? 0 : (uint64_t)&ts;
+
+    // GETEVENTS is also what runs the deferred completions.
+    unsigned int flags = IORING_ENTER_EXT_ARG;
+    if (wait > 0 || (flags_ & IORING_SETUP_DEFER_TASKRUN)) {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+
+    int ret = syscall(__NR_io_uring_enter, fd_, tail_ - submitted_, wait,
+                      flags, &arg, sizeof(arg));
+    if (ret < 0) {
+        if (errno == ETIME || errno == EINTR || errno == EBUSY) return 0;
+        perror("error on io_uring_enter()");
+        return 1;
+    }
+    submitted_ += ret;
+
+    return 0;
+}
+
+bool Uring::next(struct io_uring_cqe& cqe) {
+    unsigned int head = *cqhead_;
+    if (head == load(cqtail_)) return false;
+
+    cqe = cqes_[head & cqmask_];
+    store(cqhead_, head + 1);
+    return true;
+}
+
+int Uring::provide(const unsigned short group, const unsigned int count,
+                   const size_t size) {
+    size_ = size;
+    count_ = count;
+
+    bufringlen_ = count * sizeof(struct io_uring_buf);
+    // the ring is populated, so the kernel doesn't pin the zero page.
+    void* bufring = mmap(nullptr, bufringlen_, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    void* buffers = mmap(nullptr, count * size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bufring_ = static_cast<struct io_uring_buf_ring*>(bufring);
+    buffers_ = static_cast<unsigned char*>(buffers);
+    if (bufring == MAP_FAILED || buffers == MAP_FAILED) {
+        perror("error on mmap()");
+        return 1;
+    }
+
+    struct io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)bufring;
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PBUF_RING, &reg,
+                1) < 0) {
+        return 1;
+    }
+
+    for (unsigned int i = 0; i < count; i++) recycle(i);
+
+    return 0;
+}
+
+void Uring::recycle(const unsigned short bid) {
+    // bufs of io_uring_buf_ring is misplaced in C++, where the empty struct
+    // in front of it takes a byte. The tail overlays the first entry.
+    struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(bufring_) +
+                               (buftail_ & (count_ - 1));
+    buf->addr = (uint64_t)buffer(bid);
+    buf->len = size_;
+    buf->bid = bid;
+    buftail_++;
+    store(&bufring_->tail, buftail_);
+}
+}  // namespace dns
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <linux/io_uring.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace dns {
+
+// Uring is a thin wrapper of an io_uring instance made with the raw
+// syscalls, so liburing is not needed. It's owned by one thread.
+// Received data goes into a ring of provided buffers, which is what
+// multishot receives pick their buffers from.
+class Uring {
+public:
+    Uring();
+    ~Uring();
+
+    // remove copy constructor
+    Uring(Uring const&) = delete;
+    void operator=(Uring const&) = delete;
+
+    // open() returns 1 when io_uring is not available or too old.
+    int open(const unsigned int entries);
+
+    // sqe() returns a cleared submission entry, or nullptr when the
+    // submission queue is full.
+    struct io_uring_sqe* sqe();
+
+    // submit() submits the queued entries with one syscall, and waits for
+    // wait completions up to timeout. A negative timeout waits forever.
+    int submit(const unsigned int wait, const std::chrono::nanoseconds timeout =
+                                            std::chrono::nanoseconds(-1));
+
+    // next() copies the next completion and consumes it.
+    bool next(struct io_uring_cqe& cqe);
+
+    // provide() registers count (a power of two) buffers of size bytes as
+    // the buffer group.
+    int provide(const unsigned short group, const unsigned int count,
+                const size_t size);
+    unsigned char* buffer(const unsigned short bid) const {
+        return buffers_ + bid * size_;
+    }
+    // recycle() gives a buffer back to the kernel.
+    void recycle(const unsigned short bid);
+
+private:
+    int fd_;
+    unsigned int flags_;
+
+    void* ring_;
+    size_t ringlen_;
+    struct io_uring_sqe* sqes_;
+    size_t sqeslen_;
+
+    // submission queue.
+    unsigned int* sqhead_;
+    unsigned int* sqtail_;
+    unsigned int sqmask_;
+    unsigned int sqentries_;
+    unsigned int tail_;
+    unsigned int submitted_;
+
+    // completion queue.
+    unsigned int* cqhead_;
+    unsigned int* cqtail_;
+    unsigned int cqmask_;
+    struct io_uring_cqe* cqes_;
+
+    // provided buffers.
+    struct io_uring_buf_ring* bufring_;
+    size_t bufringlen_;
+    unsigned char* buffers_;
+    size_t size_;
+    unsigned int count_;
+    unsigned short buftail_;
+};
+}  // namespace dns
@@ -0,0 +1,174 @@
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstring>
+
+#include "./dns_verify.hpp"
+
+namespace dns {
+
+// names are compared in lower case without the trailing dot.
+static std::string canonical(std::string data) {
+    if (data.size() > 1 && data.back() == '.') data.pop_back();
+    std::transform(data.begin(), data.end(), data.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return data;
+}
+
+// rdata() returns the data of the record as --expect takes it, or an empty
+// string for types it doesn't know.
+static std::string rdata(const ns_msg& msg, const ns_rr& rr) {
+    char buf[std::max(INET6_ADDRSTRLEN, NS_MAXDNAME)];
+    const unsigned char* cp = ns_rr_rdata(rr);
+    size_t rdlen = ns_rr_rdlen(rr);
+
+    switch (ns_rr_type(rr)) {
+        case ns_t_a:
+            if (rdlen != NS_INADDRSZ) return "";
+            return inet_ntop(AF_INET, cp, buf, sizeof(buf));
+        case ns_t_aaaa:
+            if (rdlen != NS_IN6ADDRSZ) return "";
+            return inet_ntop(AF_INET6, cp, buf, sizeof(buf));
+        case ns_t_mx:
+            if (rdlen < NS_INT16SZ) return "";
+            cp += NS_INT16SZ;
+            [[fallthrough]];
+        case ns_t_cname:
+        case ns_t_ns:
+        case ns_t_ptr:
+            if (ns_name_uncompress(ns_msg_base(msg), ns_msg_end(msg), cp, buf,
+                                   sizeof(buf)) < 0) {
+                return "";
+            }
+            return canonical(buf);
+        case ns_t_txt:
+            if (rdlen < 1 || *cp + 1u > rdlen) return "";
+            return std::string(reinterpret_cast<const char*>(cp + 1), *cp);
+        default:
+            return "";
+    }
+}
+
+Verifier::Verifier(const std::vector<std::string>& expected,
+                   const unsigned int workers)
+    : rings_(workers), stopped_(false), stats_() {
+    for (const std::string& data : expected) {
+        expected_.insert(canonical(data));
+    }
+}
+
+Verifier::~Verifier() { stop(); }
+
+void Verifier::start() {
+    stopped_ = false;
+    thread_ = std::thread([this] { run(); });
+}
+
+void Verifier::stop() {
+    if (!thread_.joinable()) return;
+    stopped_ = true;
+    thread_.join();
+}
+
+bool Verifier::submit(const unsigned int worker, const unsigned char* data,
+                      const size_t len) {
+    if (len > VERIFY_PACKET_SIZE) return false;
+
+    Packet* packet = rings_[worker].slot();
+    if (packet == nullptr) return false;
+    packet->length = len;
+    std::memcpy(packet->data, data, len);
+    rings_[worker].commit();
+    return true;
+}
+
+void Verifier::run() {
+    bool stopping;
+    do {
+        // workers are done when stopped_ is seen, so nothing is left behind
+        // after the rings are drained.
+        stopping = stopped_;
+
+        bool idle = true;
+        for (Ring<Packet, VERIFY_RING>& ring : rings_) {
+            const Packet* packet;
+            while ((packet = ring.front()) != nullptr) {
+                verify(*packet);
+                ring.consume();
+                idle = false;
+            }
+        }
+
+        if (idle && !stopping) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(VERIFY_NAP));
+        }
+    } while (!stopping);
+}
+
+// verify() follows the answer section from the question name through its
+// CNAMEs. Every record has to be on that chain, and the records of the
+// queried type have to hold expected data. Answers with an error RCODE are
+// only decoded.
+void Verifier::verify(const Packet& packet) {
+    stats_.verified++;
+
+    ns_msg msg;
+    ns_rr question;
+    if (ns_initparse(packet.data, packet.length, &msg) < 0 ||
+        ns_msg_count(msg, ns_s_qd) != 1 ||
+        ns_parserr(&msg, ns_s_qd, 0, &question) < 0) {
+        stats_.malformed++;
+        return;
+    }
+    if (ns_msg_getflag(msg, ns_f_rcode) != ns_r_noerror ||
+        ns_msg_getflag(msg, ns_f_tc)) {
+        return;
+    }
+
+    unsigned short qtype = ns_rr_type(question);
+    int count = ns_msg_count(msg, ns_s_an);
+    std::vector<ns_rr> records(count);
+    for (int i = 0; i < count; i++) {
+        if (ns_parserr(&msg, ns_s_an, i, &records[i]) < 0) {
+            stats_.malformed++;
+            return;
+        }
+    }
+
+    std::vector<bool> chained(count, false);
+    std::string name = canonical(ns_rr_name(question));
+    bool found = false;
+    bool unexpected = false;
+    // a chain longer than the records loops.
+    for (int hops = 0; hops <= count; hops++) {
+        std::string next;
+        for (int i = 0; i < count; i++) {
+            const ns_rr& rr = records[i];
+            if (chained[i] || canonical(ns_rr_name(rr)) != name) {
+                continue;
+            }
+            chained[i] = true;
+
+            if (ns_rr_type(rr) == qtype) {
+                found = true;
+                if (!expected_.empty() && expected_.count(rdata(msg, rr)) == 0) {
+                    unexpected = true;
+                }
+            } else if (ns_rr_type(rr) == ns_t_cname) {
+                next = rdata(msg, rr);
+            }
+        }
+        if (next.empty()) break;
+        name = next;
+    }
+
+    if (std::find(chained.begin(), chained.end(), false) != chained.end()) {
+        stats_.broken++;
+    } else if (unexpected || (!expected_.empty() && !found)) {
+        stats_.unexpected++;
+    }
+}
+}  // namespace dns
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+#include "./dns_client.hpp"
+#include "./dns_ring.hpp"
+
+// answers a worker can hand over before the verifier takes them.
+#define VERIFY_RING 256
+// answers longer than this are not copied, and counted as skipped.
+#define VERIFY_PACKET_SIZE EDNS0_BUFFER_SIZE
+// how long the verifier sleeps in milliseconds when every queue is empty.
+#define VERIFY_NAP 1
+
+namespace dns {
+
+struct VerifyStats {
+    // answers picked by the workers, every 1 in N and every anomalous one,
+    // and those dropped because the queue of the verifier was full.
+    uint64_t sampled;
+    uint64_t anomalous;
+    uint64_t skipped;
+
+    // answers verified, and what was wrong with them: not decodable, records
+    // off the CNAME chain of the question, or data not expected.
+    uint64_t verified;
+    uint64_t malformed;
+    uint64_t broken;
+    uint64_t unexpected;
+
+    uint64_t mismatches() const { return malformed + broken + unexpected; }
+
+    void merge(const VerifyStats& other) {
+        sampled += other.sampled;
+        anomalous += other.anomalous;
+        skipped += other.skipped;
+        verified += other.verified;
+        malformed += other.malformed;
+        broken += other.broken;
+        unexpected += other.unexpected;
+    }
+};
+
+// Verifier decodes answers on a thread of its own, so that workers only pay
+// for a copy. Every worker hands answers over through its own ring, and
+// records are decoded lazily: only those on the CNAME chain from the
+// question name are.
+class Verifier {
+public:
+    // expected is the data the records of the queried type must be one of,
+    // e.g. addresses. Any data is accepted when it's empty.
+    Verifier(const std::vector<std::string>& expected,
+             const unsigned int workers);
+    ~Verifier();
+
+    // remove copy constructor
+    Verifier(Verifier const&) = delete;
+    void operator=(Verifier const&) = delete;
+
+    void start();
+    // stop() returns when every answer handed over is verified.
+    void stop();
+
+    // submit() copies the answer for the verifier, and returns false if it
+    // was dropped. Called by worker only.
+    bool submit(const unsigned int worker, const unsigned char* data,
+                const size_t len);
+
+    // stats() is read after stop().
+    const VerifyStats& stats() const { return stats_; }
+
+private:
+    struct Packet {
+        size_t length;
+        unsigned char data[VERIFY_PACKET_SIZE];
+    };
+
+    std::unordered_set<std::string> expected_;
+    std::vector<Ring<Packet, VERIFY_RING>> rings_;
+
+    std::thread thread_;
+    std::atomic<bool> stopped_;
+
+    VerifyStats stats_;
+
+    void run();
+    void verify(const Packet& packet);
+};
+}  // namespace dns
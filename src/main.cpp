@@ -1,30 +1,124 @@
+#include <arpa/nameser.h>
+
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <csignal>
+#include <limits>
 
 #include <boost/program_options.hpp>
 
 #include "config.h"
 #include "./dns_client.hpp"
 #include "./dns_tester.hpp"
+#include "./dns_process.hpp"
+#include "./dns_compare.hpp"
+#include "./dns_search.hpp"
+#include "./dns_query.hpp"
+#include "./dns_corpus.hpp"
+#include "./dns_affinity.hpp"
+#include "./dns_tls.hpp"
+#include "./dns_resolver.hpp"
+#include "./dns_metrics.hpp"
+#include "./dns_agent.hpp"
+#include "./dns_controller.hpp"
 #include "./utils.hpp"
 
 namespace bpo = boost::program_options;
 
+// looks the name up for --check, and prints the answer.
+static dns::Task check(dns::Resolver& resolver, const std::string name,
+                       const dns::Type type, int& status) {
+    std::shared_ptr<dns::Answer> answer =
+        co_await resolver.co_resolve(name, type);
+    if (!answer) {
+        std::cerr << "no DNS answer was received" << std::endl;
+        co_return;
+    }
+    if (dns::Client::print(answer)) {
+        std::cerr << "failed to print DNS answer" << std::endl;
+        co_return;
+    }
+    // an error RCODE or a truncated answer is printed, but is no answer.
+    if (answer->status == dns::Answer::Ok) status = 0;
+}
+
+// prints a row of the breakdown tables.
+static void printRow(const char* name, const dns::TypeStats& typed) {
+    std::cout << std::left << std::setw(8) << name << std::right
+              << std::setw(12) << typed.success + typed.failure
+              << std::setw(12) << typed.failure
+              << std::fixed << std::setprecision(3)
+              << std::setw(12) << typed.latency.mean() / 1e6
+              << std::setw(12) << typed.latency.percentile(50) / 1e6
+              << std::setw(12) << typed.latency.percentile(99) / 1e6
+              << std::setw(12) << typed.outcomes.rcodes[ns_r_nxdomain]
+              << std::setw(12) << typed.outcomes.rcodes[ns_r_servfail] << std::endl;
+}
+
+// prints the header of the breakdown tables.
+static void printHeader(const char* name) {
+    std::cout << std::left << std::setw(8) << name << std::right
+              << std::setw(12) << "Queries" << std::setw(12) << "Failure"
+              << std::setw(12) << "Avg (ms)" << std::setw(12) << "50th (ms)"
+              << std::setw(12) << "99th (ms)" << std::setw(12) << "NXDOMAIN"
+              << std::setw(12) << "SERVFAIL" << std::endl;
+}
+
 int main(int argc, char** argv) {
     bpo::options_description desc("Allowed options");
     desc.add_options()
         ("help,h", "print help messages")
         ("verbose,v", "be verbose")
-        ("server,n", bpo::value<std::string>(), "name server address")
+        ("server,n", bpo::value<std::vector<std::string>>(), "name server address, repeated with --compare")
+        ("port", bpo::value<int>()->default_value(DNS_PORT), "name server port")
         ("type,q", bpo::value<std::string>()->default_value("A"), "type of DNS queries")
         ("count,c", bpo::value<int>()->default_value(1), "number of DNS queries")
         ("thread_num,t", bpo::value<int>()->default_value(1), "number of threads in each process")
-        // TODO: implement multi-porcesses soon
-        // ("process_num,p", bpo::value<int>()->default_value(1), "number of processes")
+        ("process_num,p", bpo::value<int>()->default_value(1), "number of processes")
+        ("sockets,s", bpo::value<int>()->default_value(1), "number of UDP sockets in each thread")
+        ("inflight,w", bpo::value<int>()->default_value(1), "number of outstanding queries in each thread")
+        ("tcp", "send queries over TCP")
+        ("tls", "send queries over TLS (port 853 unless --port is given)")
+        ("tls_name", bpo::value<std::string>()->default_value(""), "verify the TLS certificate for this name (any certificate is accepted without it)")
+        ("tls_ca", bpo::value<std::string>()->default_value(""), "CA certificates to verify the TLS certificate with instead of the system ones")
+        ("cpus", bpo::value<std::string>(), "pin threads to these CPUs in turn e.g. 0-3,8")
+        ("numa", bpo::value<std::string>(), "pin threads to the CPUs of these NUMA nodes e.g. 0,1")
+        ("source_port", bpo::value<int>()->default_value(0), "bind sockets to consecutive source ports from this port (0 uses ephemeral ports)")
+        ("io_uring", "send and receive UDP with io_uring, or epoll if it's not available")
+        ("timestamps", "time UDP queries and answers with kernel timestamps, and report how long answers wait to be read")
+        ("batch,b", bpo::value<int>()->default_value(1), "number of packets per sendmmsg/recvmmsg call")
+        ("qps", bpo::value<double>()->default_value(0), "send queries at a constant rate regardless of answers (open-loop)")
+        ("duration", bpo::value<int>()->default_value(0), "send queries for milliseconds with --qps instead of --count queries")
+        ("timeout", bpo::value<int>()->default_value(5000), "give up a query without answer after milliseconds (0 waits forever)")
+        ("retries", bpo::value<int>()->default_value(0), "number of times a query without answer is resent over UDP")
+        ("interval", bpo::value<int>()->default_value(0), "write a snapshot every milliseconds during the test (0 turns it off)")
+        ("format", bpo::value<std::string>()->default_value("json"), "format of the snapshots: json (JSON Lines) or csv")
+        ("output,o", bpo::value<std::string>()->default_value(""), "file to write the snapshots to instead of stdout")
+        ("metrics_port", bpo::value<int>()->default_value(0), "serve live counters and answer times in the Prometheus format at http://127.0.0.1:<port>/metrics during the test (0 turns it off)")
         ("version", "print version")
         ("norecurse", "turn off recursive DNS option")
         ("noedns", "turn off EDNS option")
         ("check", "send single query and show answer")
+        ("agent_port", bpo::value<int>()->default_value(0), "run as an agent which runs the tests of controllers (--agent) on this port, with its own --cpus, --source_port, --tls_ca, --io_uring and --timestamps")
+        ("agent_address", bpo::value<std::string>()->default_value("127.0.0.1"), "address the agent listens on, which needs --agent_token unless it's loopback")
+        ("agent_token", bpo::value<std::string>()->default_value(""), "secret the agent and its controllers share, sent in the clear")
+        ("agent", bpo::value<std::vector<std::string>>(), "run the test on the agent at host:port, repeated for every agent, and report the combined results")
+        ("compare", "benchmark the name servers side by side (all in resolv.conf unless -n is given)")
+        ("verify", bpo::value<int>()->default_value(0), "decode 1 in N answers, and every anomalous one, in full on a background thread and report mismatches (0 turns it off)")
+        ("expect", bpo::value<std::vector<std::string>>(), "data the records of the queried type must hold with --verify e.g. an address, repeated for a set")
+        ("search", "raise the open-loop rate step by step until the SLO is breached, and report the highest rate which met it")
+        ("slo", bpo::value<double>()->default_value(10), "answer time in milliseconds the SLO percentile must stay under with --search")
+        ("slo_percentile", bpo::value<double>()->default_value(99), "percentile of the answer time the SLO applies to")
+        ("max_failure", bpo::value<double>()->default_value(0.01), "ratio of failed queries the SLO allows (0 - 1)")
+        ("search_start", bpo::value<double>()->default_value(1000), "rate in qps of the first step of --search")
+        ("search_step", bpo::value<double>()->default_value(0), "rate in qps added every step until the SLO is breached (0 doubles the rate)")
+        ("search_duration", bpo::value<int>()->default_value(5000), "milliseconds every step of --search sends queries for")
+        ("queries,f", bpo::value<std::string>(), "replay queries from a file with \"name type\" per line")
+        ("shuffle", "send queries from the file in random order")
+        ("label", bpo::value<std::string>(), "prepend a unique label to every name to miss the cache: random or sequential")
+        ("hit_ratio", bpo::value<double>()->default_value(0), "ratio of queries sent for the names as given with --label (0 - 1)")
         ("domain",  "target domain e.g. www.google.com")
     ;
 
@@ -40,69 +134,432 @@ int main(int argc, char** argv) {
     if (vm.count("version")) {
         std::cout << DNS_BENCHMARK_VERSION << std::endl;
         return 1;
-    } else if (vm.count("help") || !vm.count("domain")) {
+    } else if (vm.count("help") ||
+               (!vm.count("domain") && !vm.count("queries") &&
+                vm["agent_port"].as<int>() == 0)) {
         std::cout << desc << std::endl;
         return 1;
     }
 
-    std::string domain = vm["domain"].as<std::string>();
+    std::string domain =
+        vm.count("domain") ? vm["domain"].as<std::string>() : "";
     std::string type = util::uppercase(vm["type"].as<std::string>());
 
     dns::Type query;
-    if (type == "AAAA") {
-        query = dns::AAAA;
-    } else if (type == "PTR") {
-        query = dns::PTR;
-    } else if (type == "CNAME") {
-        query = dns::CNAME;
-    } else if (type == "MX") {
-        query = dns::MX;
-    } else if (type == "TXT") {
-        query = dns::TXT;
-    } else if (type == "NS") {
-        query = dns::NS;
-    } else if (type == "SOA") {
-        query = dns::SOA;
-    } else {
+    if (dns::parseType(type, query)) {
         query = dns::A;
     }
 
-    std::string ns;
+    std::vector<std::string> servers;
     if (vm.count("server")) {
-        ns = vm["server"].as<std::string>();
+        servers = vm["server"].as<std::vector<std::string>>();
     }
+    std::string ns = !servers.empty() ? servers.front() : "";
 
     bool recurse = !vm.count("norecurse");
     bool edns = !vm.count("noedns");
 
     if (vm.count("check")) {
-        dns::Client* client =
-            !ns.empty() ? new dns::Client(ns) : new dns::Client();
-        client->resolv(domain, query, recurse, edns);
+        if (domain.empty()) {
+            std::cout << desc << std::endl;
+            return 1;
+        }
+        dns::Transport transport = vm.count("tls")   ? dns::TLS
+                                   : vm.count("tcp") ? dns::TCP
+                                                     : dns::UDP;
+        int port = vm["port"].as<int>();
+        if (transport == dns::TLS && vm["port"].defaulted()) port = DNS_TLS_PORT;
+        if (transport == dns::TLS) std::signal(SIGPIPE, SIG_IGN);
+
+        dns::Resolver resolver(ns, port, 1, transport);
+        resolver.setTimeout(std::chrono::milliseconds(vm["timeout"].as<int>()),
+                            vm["retries"].as<int>());
+        resolver.setTls(vm["tls_name"].as<std::string>(),
+                        vm["tls_ca"].as<std::string>());
+        resolver.setFlags(recurse, edns);
+        if (resolver.open()) return 1;
+
+        int status = 1;
+        check(resolver, domain, query, status);
+        if (resolver.run()) return 1;
+        return status;
+    }
+
+    dns::TestConfig config;
+    config.target = domain;
+    config.query = query;
+    if (vm.count("queries")) {
+        config.corpus = std::make_shared<dns::Corpus>();
+        if (config.corpus->load(vm["queries"].as<std::string>())) {
+            return 1;
+        }
+        domain = vm["queries"].as<std::string>();
+        type = std::to_string(config.corpus->size()) + " queries";
+    }
+    config.shuffle = vm.count("shuffle");
+    config.labels = dns::FIXED;
+    if (vm.count("label")) {
+        std::string label = util::lowercase(vm["label"].as<std::string>());
+        if (label == "random") {
+            config.labels = dns::RANDOM;
+        } else if (label == "sequential") {
+            config.labels = dns::SEQUENTIAL;
+        } else {
+            std::cerr << "unknown label: " << label << std::endl;
+            return 1;
+        }
+    }
+    config.hitRatio = vm["hit_ratio"].as<double>();
+    if (config.hitRatio < 0 || config.hitRatio > 1) {
+        std::cerr << "hit ratio is out of 0 - 1" << std::endl;
+        return 1;
+    }
+    config.ns = ns;
+    config.port = vm["port"].as<int>();
+    if (vm.count("tls") && vm["port"].defaulted()) config.port = DNS_TLS_PORT;
+    config.recurse = recurse;
+    config.edns = edns;
+    config.samples = vm["count"].as<int>();
+    config.concurrency = vm["thread_num"].as<int>();
+    config.process = 0;
+    config.processes = 1;
+    config.server = 0;
+    config.servers = 1;
+    config.sockets = vm["sockets"].as<int>();
+    config.inflight = vm["inflight"].as<int>();
+    config.batch = vm["batch"].as<int>();
+    config.transport = vm.count("tls")   ? dns::TLS
+                       : vm.count("tcp") ? dns::TCP
+                                         : dns::UDP;
+    config.tlsName = vm["tls_name"].as<std::string>();
+    config.tlsCa = vm["tls_ca"].as<std::string>();
+    // a connection closed by the server must not kill the benchmark while
+    // OpenSSL writes to it.
+    if (config.transport == dns::TLS) std::signal(SIGPIPE, SIG_IGN);
+    config.backend = vm.count("io_uring") ? dns::IO_URING : dns::EPOLL;
+    if (vm.count("cpus") &&
+        dns::parseCpus(vm["cpus"].as<std::string>(), config.cpus)) {
+        std::cerr << "CPU list is invalid" << std::endl;
+        return 1;
+    }
+    if (vm.count("numa")) {
+        std::vector<int> nodes;
+        if (dns::parseCpus(vm["numa"].as<std::string>(), nodes)) {
+            std::cerr << "NUMA node list is invalid" << std::endl;
+            return 1;
+        }
+        for (int node : nodes) {
+            if (dns::numaCpus(node, config.cpus)) return 1;
+        }
+    }
+    config.sourcePort = vm["source_port"].as<int>();
+    config.timestamps = vm.count("timestamps");
+    if (config.timestamps && (config.transport != dns::UDP || vm.count("io_uring"))) {
+        std::cerr << "--timestamps applies to UDP with epoll" << std::endl;
+        return 1;
+    }
+    config.timeout = std::chrono::milliseconds(vm["timeout"].as<int>());
+    config.retries = vm["retries"].as<int>();
+    config.qps = vm["qps"].as<double>();
+    if (vm["duration"].as<int>() > 0) {
+        if (config.qps <= 0) {
+            std::cerr << "--duration needs --qps" << std::endl;
+            return 1;
+        }
+        double samples = config.qps * vm["duration"].as<int>() / 1000;
+        if (samples > std::numeric_limits<unsigned int>::max()) {
+            std::cerr << "--qps and --duration make more than "
+                      << std::numeric_limits<unsigned int>::max() << " queries" << std::endl;
+            return 1;
+        }
+        config.samples = std::max(samples, 1.0);
+    }
+    if (vm["verify"].as<int>() < 0) {
+        std::cerr << "--verify takes 1 in N answers" << std::endl;
+        return 1;
+    }
+    config.verify = vm["verify"].as<int>();
+    if (vm.count("expect")) {
+        if (config.verify == 0) {
+            std::cerr << "--expect needs --verify" << std::endl;
+            return 1;
+        }
+        config.expected = vm["expect"].as<std::vector<std::string>>();
+    }
+    config.verbose = vm.count("verbose");
+
+    // the plans of controllers take the place of these options.
+    if ((vm["agent_port"].as<int>() > 0 || vm.count("agent")) &&
+        (vm["process_num"].as<int>() > 1 || vm.count("compare") ||
+         vm.count("search") || vm["interval"].as<int>() > 0 ||
+         vm["metrics_port"].as<int>() > 0)) {
+        std::cerr << "--agent_port and --agent run without -p, --compare, --search, --interval and --metrics_port" << std::endl;
+        return 1;
+    }
+    if (vm["agent_port"].as<int>() > 0) {
+        // plans may run over TLS.
+        std::signal(SIGPIPE, SIG_IGN);
+        dns::Agent agent(config, vm["agent_token"].as<std::string>());
+        return agent.run(vm["agent_address"].as<std::string>(), vm["agent_port"].as<int>());
+    }
+    config.interval = std::chrono::milliseconds(vm["interval"].as<int>());
+    if (config.interval.count() > 0) {
+        if (vm["process_num"].as<int>() > 1) {
+            std::cerr << "--interval runs in one process" << std::endl;
+            return 1;
+        }
+
+        std::string format = util::lowercase(vm["format"].as<std::string>());
+        if (format != "json" && format != "csv") {
+            std::cerr << "unknown format: " << format << std::endl;
+            return 1;
+        }
+        config.intervals = std::make_shared<dns::IntervalWriter>(
+            format == "csv" ? dns::IntervalWriter::CSV : dns::IntervalWriter::JSON);
+        if (config.intervals->open(vm["output"].as<std::string>())) {
+            return 1;
+        }
+    }
+
+    if (vm.count("compare") && servers.empty()) {
+        servers = dns::ConfigLoader::getInstance().load();
+    }
+
+    if (vm["metrics_port"].as<int>() > 0) {
+        // series are labeled with the servers tested.
+        std::vector<std::string> labels = servers;
+        if (!vm.count("compare")) {
+            labels = {!ns.empty() ? ns : dns::ConfigLoader::getInstance().load().front()};
+        }
+        config.metrics = std::make_shared<dns::MetricsExporter>(
+            labels, config.concurrency * std::max(vm["process_num"].as<int>(), 1));
+        if (config.metrics->start(vm["metrics_port"].as<int>())) {
+            return 1;
+        }
+    }
+
+    if (vm.count("compare")) {
+        if (vm["process_num"].as<int>() > 1) {
+            std::cerr << "--compare runs in one process" << std::endl;
+            return 1;
+        }
+
+        std::unique_ptr<dns::CompareTester> tester =
+            std::make_unique<dns::CompareTester>(config, servers);
+        tester->run();
+        std::vector<dns::CompareTester::Result> results = tester->report();
+
+        std::cout << "Target Domain: " << domain << " (" << type << ")" << std::endl;
+        std::cout << "--------------------------------------" << std::endl;
+        std::cout << std::left << std::setw(4) << "#" << std::setw(20) << "Server" << std::right
+                  << std::setw(10) << "Queries" << std::setw(10) << "Failure" << std::setw(10) << "Timeouts"
+                  << std::setw(12) << "Avg (ms)" << std::setw(12) << "50th (ms)" << std::setw(12) << "99th (ms)"
+                  << std::setw(12) << "Max (ms)" << std::setw(12) << "Rate (qps)" << std::endl;
+        for (size_t i = 0; i < results.size(); i++) {
+            const dns::CompareTester::Result& result = results[i];
+            std::cout << std::left << std::setw(4) << i + 1 << std::setw(20) << result.server << std::right;
+            if (!result.stats) {
+                std::cout << std::setw(10) << config.samples << "  no DNS answer was received" << std::endl;
+                continue;
+            }
+            std::cout << std::setw(10) << result.stats->samples
+                      << std::setw(10) << result.stats->failure
+                      << std::setw(10) << result.stats->timeouts
+                      << std::fixed << std::setprecision(3);
+            if (result.stats->latency.count() > 0) {
+                std::cout << std::setw(12) << result.stats->avgTime
+                          << std::setw(12) << result.stats->percentile(50)
+                          << std::setw(12) << result.stats->percentile(99)
+                          << std::setw(12) << result.stats->maxTime;
+            } else {
+                // answer times of a server which never answered are not 0.
+                std::cout << std::setw(12) << "-" << std::setw(12) << "-"
+                          << std::setw(12) << "-" << std::setw(12) << "-";
+            }
+            std::cout << std::setprecision(1) << std::setw(12) << result.stats->answerRate << std::endl;
+        }
         return 0;
     }
 
-    std::unique_ptr<dns::Tester> tester = std::make_unique<dns::Tester>(
-        /* domain */ domain,
-        /* query */ query,
-        /* samples */ vm["count"].as<int>(),
-        /* concurrency */ vm["thread_num"].as<int>(),
-        /* verbose */ vm.count("verbose"));
+    if (vm.count("search")) {
+        if (vm["process_num"].as<int>() > 1 || config.intervals) {
+            std::cerr << "--search runs in one process without --interval" << std::endl;
+            return 1;
+        }
+        dns::SearchConfig search;
+        search.slo = vm["slo"].as<double>();
+        search.percentile = vm["slo_percentile"].as<double>();
+        search.maxFailure = vm["max_failure"].as<double>();
+        search.start = vm["search_start"].as<double>();
+        search.step = vm["search_step"].as<double>();
+        search.duration = std::chrono::milliseconds(vm["search_duration"].as<int>());
+        if (search.start <= 0 || search.step < 0 || search.duration.count() <= 0 ||
+            search.percentile <= 0 || search.percentile > 100) {
+            std::cerr << "search parameters are invalid" << std::endl;
+            return 1;
+        }
+
+        std::unique_ptr<dns::SearchTester> tester =
+            std::make_unique<dns::SearchTester>(config, search);
+        tester->run();
+        std::vector<dns::SearchTester::Step> steps = tester->report();
 
-    tester->run();
+        static const char* verdicts[] = {"ok", "latency", "failure", "rate", "silent"};
+        std::ostringstream percentile;
+        percentile << std::defaultfloat << search.percentile << "th";
+        std::cout << "Target Domain: " << domain << " (" << type << ")" << std::endl;
+        std::cout << "SLO: " << percentile.str() << " Answer Time < "
+                  << std::fixed << std::setprecision(3) << search.slo << " ms, Failure <= "
+                  << std::setprecision(2) << search.maxFailure * 100 << "%" << std::endl;
+        std::cout << "--------------------------------------" << std::endl;
+        std::cout << std::right << std::setw(12) << "Rate (qps)" << std::setw(12) << "Sent (qps)"
+                  << std::setw(14) << "Answer (qps)" << std::setw(10) << "Failure"
+                  << std::setw(12) << "50th (ms)" << std::setw(14) << percentile.str() + " (ms)"
+                  << std::setw(12) << "Max (ms)" << std::setw(10) << "Result" << std::endl;
+        for (const dns::SearchTester::Step& step : steps) {
+            std::cout << std::fixed << std::setprecision(1) << std::setw(12) << step.rate;
+            if (!step.stats) {
+                std::cout << "  no DNS answer was received" << std::endl;
+                continue;
+            }
+            std::cout << std::setw(12) << step.stats->sendRate
+                      << std::setw(14) << step.stats->answerRate
+                      << std::setw(10) << step.stats->failure
+                      << std::setprecision(3);
+            if (step.stats->latency.count() > 0) {
+                std::cout << std::setw(12) << step.stats->percentile(50)
+                          << std::setw(14) << step.stats->percentile(search.percentile)
+                          << std::setw(12) << step.stats->maxTime;
+            } else {
+                std::cout << std::setw(12) << "-" << std::setw(14) << "-" << std::setw(12) << "-";
+            }
+            std::cout << std::setw(10) << verdicts[step.verdict] << std::endl;
+        }
+        std::cout << "--------------------------------------" << std::endl;
+        if (tester->sustainable() > 0) {
+            std::cout << "Sustainable Rate (qps): " << std::fixed << std::setprecision(1) << tester->sustainable() << std::endl;
+        } else {
+            std::cout << "Sustainable Rate (qps): no rate met the SLO" << std::endl;
+        }
+        return 0;
+    }
 
-    std::unique_ptr<dns::TestStats> stats = tester->report();
+    // a run which lost some of its processes or agents still reports the
+    // others, says so, and fails.
+    int status = 0;
+    std::string partial;
+    std::unique_ptr<dns::TestStats> stats;
+    if (vm.count("agent")) {
+        std::unique_ptr<dns::ControllerTester> tester = std::make_unique<dns::ControllerTester>(
+            config, vm["agent"].as<std::vector<std::string>>(), vm["agent_token"].as<std::string>());
+        status = tester->run();
+        stats = tester->report();
+        partial = std::to_string(tester->contributed()) + " of " +
+                  std::to_string(vm["agent"].as<std::vector<std::string>>().size()) + " agents";
+    } else if (vm["process_num"].as<int>() > 1) {
+        std::unique_ptr<dns::ProcessTester> tester =
+            std::make_unique<dns::ProcessTester>(config, vm["process_num"].as<int>());
+        status = tester->run();
+        stats = tester->report();
+        partial = std::to_string(tester->contributed()) + " of " +
+                  std::to_string(vm["process_num"].as<int>()) + " processes";
+    } else {
+        std::unique_ptr<dns::Tester> tester = std::make_unique<dns::Tester>(config);
+        tester->run();
+        stats = tester->report();
+    }
+    if (!stats) {
+        std::cerr << "no DNS query was sent" << std::endl;
+        return 1;
+    }
 
+    // a run without answers still reports why, e.g. its timeouts.
+    bool answered = stats->latency.count() > 0;
     std::cout << "Target Domain: " << domain << " (" << type << ")" << std::endl;
     std::cout << "--------------------------------------" << std::endl;
-    std::cout << "Avg Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->avgTime << std::endl;
-    std::cout << "Max Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->maxTime << std::endl;
-    std::cout << "Min Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->minTime << std::endl;
-    std::cout << "70th Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->prctileTime70 << std::endl;
-    std::cout << "80th Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->prctileTime80 << std::endl;
-    std::cout << "90th Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->prctileTime90 << std::endl;
-    std::cout << "95th Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->prctileTime95 << std::endl;
+    if (answered) {
+        std::cout << "Avg Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->avgTime << std::endl;
+        std::cout << "Max Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->maxTime << std::endl;
+        std::cout << "Min Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->minTime << std::endl;
+        for (double p : {50.0, 70.0, 80.0, 90.0, 95.0, 99.0, 99.9, 99.99, 99.999}) {
+            std::cout << std::defaultfloat << std::setprecision(6) << p << "th Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->percentile(p) << std::endl;
+        }
+    } else {
+        std::cout << "no DNS answer was received" << std::endl;
+    }
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << "Duration (s): " << std::fixed << std::setprecision(3) << stats->duration << std::endl;
+    std::cout << "Answer Rate (qps): " << std::fixed << std::setprecision(1) << stats->answerRate << std::endl;
+    if (stats->targetRate > 0) {
+        std::cout << "Target Rate (qps): " << std::fixed << std::setprecision(1) << stats->targetRate << std::endl;
+        std::cout << "Achieved Rate (qps): " << std::fixed << std::setprecision(1) << stats->sendRate << std::endl;
+    }
+    if (stats->connects > 0) {
+        std::cout << "TCP Connections: " << stats->connects << std::endl;
+        std::cout << "Avg Connect Time (ms): " << std::fixed << std::setprecision(3) << stats->setup.mean() / 1e6 << std::endl;
+        std::cout << "Max Connect Time (ms): " << std::fixed << std::setprecision(3) << stats->setup.max() / 1e6 << std::endl;
+    }
+    if (stats->handshake.count() + stats->resumption.count() > 0) {
+        std::cout << "TLS Full Handshakes: " << stats->handshake.count() << std::endl;
+        std::cout << "Avg Full Handshake Time (ms): " << std::fixed << std::setprecision(3) << stats->handshake.mean() / 1e6 << std::endl;
+        std::cout << "TLS Resumed Handshakes: " << stats->resumption.count() << std::endl;
+        std::cout << "Avg Resumed Handshake Time (ms): " << std::fixed << std::setprecision(3) << stats->resumption.mean() / 1e6 << std::endl;
+    }
+    if (config.timestamps) {
+        std::cout << "Kernel Timestamped Answers: " << stats->wire.count() << std::endl;
+        std::cout << "Avg Wire Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->wire.mean() / 1e6 << std::endl;
+        std::cout << "50th Wire Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->wire.percentile(50) / 1e6 << std::endl;
+        std::cout << "99th Wire Answer Time (ms): " << std::fixed << std::setprecision(3) << stats->wire.percentile(99) / 1e6 << std::endl;
+        std::cout << "Avg Receive Lag (ms): " << std::fixed << std::setprecision(3) << stats->lag.mean() / 1e6 << std::endl;
+        std::cout << "99th Receive Lag (ms): " << std::fixed << std::setprecision(3) << stats->lag.percentile(99) / 1e6 << std::endl;
+        std::cout << "Max Receive Lag (ms): " << std::fixed << std::setprecision(3) << stats->lag.max() / 1e6 << std::endl;
+    }
+    if (stats->timeouts + stats->retries + stats->late + stats->duplicates + stats->stray > 0) {
+        std::cout << "Timeouts: " << stats->timeouts << std::endl;
+        std::cout << "Retries: " << stats->retries << std::endl;
+        std::cout << "Late Answers: " << stats->late << std::endl;
+        std::cout << "Duplicate Answers: " << stats->duplicates << std::endl;
+        std::cout << "Stray Answers: " << stats->stray << std::endl;
+    }
+    for (int i = 0; i < DNS_RCODE_NUM; i++) {
+        if (stats->outcomes.rcodes[i] == 0) continue;
+        std::cout << dns::rcodeName(i) << " Answers: " << stats->outcomes.rcodes[i] << std::endl;
+    }
+    if (stats->outcomes.malformed > 0) {
+        std::cout << "Malformed Answers: " << stats->outcomes.malformed << std::endl;
+    }
+    std::cout << "Truncated (TC) Answers: " << stats->outcomes.truncated << std::endl;
+    std::cout << "Authoritative (AA) Answers: " << stats->outcomes.authoritative << std::endl;
+    std::cout << "Recursion Available (RA) Answers: " << stats->outcomes.recursive << std::endl;
+    if (config.verify > 0) {
+        const dns::VerifyStats& verify = stats->verify;
+        std::cout << "Verified Answers: " << verify.verified << std::endl;
+        std::cout << "Sampled/Anomalous/Skipped Answers: " << verify.sampled << "/" << verify.anomalous << "/" << verify.skipped << std::endl;
+        std::cout << "Mismatch Rate (%): " << std::fixed << std::setprecision(3)
+                  << (verify.verified > 0 ? 100.0 * verify.mismatches() / verify.verified : 0.0) << std::endl;
+        std::cout << "Malformed/Broken Chain/Unexpected Data: " << verify.malformed << "/" << verify.broken << "/" << verify.unexpected << std::endl;
+    }
+    std::cout << "Syscalls per Query: " << std::fixed << std::setprecision(3) << (double)stats->syscalls / stats->samples << std::endl;
+    if (config.corpus) {
+        std::cout << "--------------------------------------" << std::endl;
+        printHeader("Type");
+        for (int i = 0; i < dns::TYPE_NUM; i++) {
+            const dns::TypeStats& typed = stats->types[i];
+            if (typed.success + typed.failure == 0) continue;
+            printRow(dns::typeName(static_cast<dns::Type>(i)), typed);
+        }
+    }
+    if (config.labels != dns::FIXED) {
+        std::cout << "--------------------------------------" << std::endl;
+        printHeader("Cache");
+        printRow("Hit", stats->fixed);
+        printRow("Miss", stats->unique);
+    }
     std::cout << "(" << stats->samples << " queries)" << std::endl;
+    if (status != 0) {
+        std::cout << "(only " << partial << " contributed)" << std::endl;
+        return 1;
+    }
 
-    return 0;
+    return answered ? 0 : 1;
 }
@@ -0,0 +1,76 @@
+#include <csignal>
+#include <iostream>
+
+#include <boost/program_options.hpp>
+
+#include "config.h"
+#include "./dns_responder.hpp"
+
+namespace bpo = boost::program_options;
+
+static dns::Responder* responder = nullptr;
+
+static void stop(int) {
+    if (responder != nullptr) responder->stop();
+}
+
+int main(int argc, char** argv) {
+    bpo::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "print help messages")
+        ("address,a", bpo::value<std::string>()->default_value("127.0.0.1"), "address to listen on")
+        ("port", bpo::value<int>()->default_value(5353), "port to listen on (UDP and TCP)")
+        ("thread_num,t", bpo::value<int>()->default_value(1), "number of threads")
+        ("zone,z", bpo::value<std::string>(), "answer from a file with \"name type data\" per line instead of made up A/AAAA records")
+        ("delay", bpo::value<double>()->default_value(0), "delay every answer by milliseconds")
+        ("drop", bpo::value<double>()->default_value(0), "ratio of queries to ignore (0 - 1)")
+        ("truncate", bpo::value<double>()->default_value(0), "ratio of UDP answers to truncate (0 - 1)")
+        ("tls_port", bpo::value<int>()->default_value(0), "port to serve DNS over TLS on (0 = off)")
+        ("cert", bpo::value<std::string>()->default_value(""), "TLS certificate chain (PEM), self-signed for localhost without it")
+        ("key", bpo::value<std::string>()->default_value(""), "TLS private key (PEM)")
+        ("version", "print version")
+    ;
+
+    bpo::variables_map vm;
+    bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+    bpo::notify(vm);
+
+    if (vm.count("version")) {
+        std::cout << DNS_BENCHMARK_VERSION << std::endl;
+        return 1;
+    } else if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    dns::ResponderConfig config;
+    config.address = vm["address"].as<std::string>();
+    config.port = vm["port"].as<int>();
+    config.threads = vm["thread_num"].as<int>();
+    if (vm.count("zone")) {
+        config.zone = std::make_shared<dns::Zone>();
+        if (config.zone->load(vm["zone"].as<std::string>())) {
+            return 1;
+        }
+    }
+    config.delay = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double, std::milli>(vm["delay"].as<double>()));
+    config.drop = vm["drop"].as<double>();
+    config.truncate = vm["truncate"].as<double>();
+    config.tlsPort = vm["tls_port"].as<int>();
+    config.cert = vm["cert"].as<std::string>();
+    config.key = vm["key"].as<std::string>();
+    if (config.cert.empty() != config.key.empty()) {
+        std::cerr << "--cert and --key go together" << std::endl;
+        return 1;
+    }
+
+    dns::Responder server(config);
+    responder = &server;
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+    // clients going away while an answer is written over TLS.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    return server.run();
+}